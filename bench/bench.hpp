@@ -0,0 +1,47 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "global.hpp"
+#include "app.hpp"
+
+#include <cstdio>
+
+// Each area's benchmarks; see main.cpp.
+void BenchEvents();
+void BenchProcesses();
+void BenchEntities();
+
+// Best of runs calls of f, in milliseconds, after one to warm up; the best
+// is the least disturbed by whatever else the machine is doing.
+template<class F>
+DeltaTime BenchBest(uint32 runs, F f)
+{
+    f();
+    DeltaTime best = 0.0f;
+    for (uint32 r = 0; r < runs; r++)
+    {
+        TimeStamp start = App::Time();
+        f();
+        DeltaTime ms = App::MillisecondsElapsed(start);
+        if (r == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+inline void BenchReport(const char* name, DeltaTime milliseconds)
+{
+    std::printf("    %-52s %10.3f ms\n", name, milliseconds);
+}
+
+// Keeps the compiler from optimizing away what's being measured.
+inline volatile uint64 benchSink_ = 0;
+
+#endif // BENCH_HPP
@@ -0,0 +1,257 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "global.hpp"
+#include "app.hpp"
+#include "bench.hpp"
+#include "entity_manager.hpp"
+
+#include <memory>
+#include <vector>
+
+static const uint32 ENTITIES_ = 1000000;
+
+struct Position_ { float32 x, y, z; };
+struct Velocity_ { float32 x, y, z; };
+struct Mass_     { float32 inverse; };
+struct Health_   { float32 hp, regen; };
+
+// The layout an archetype ECS replaces: each entity a heap object holding
+// its components by pointer, found by a scan of their type IDs.
+class LegacyComponent_
+{
+public:
+    explicit LegacyComponent_(uint32 type) : m_type(type) {}
+    virtual ~LegacyComponent_() {}
+
+    uint32 Type() const { return m_type; }
+
+private:
+    uint32 m_type;
+};
+
+template<class T>
+class LegacyComponentOf_ : public LegacyComponent_
+{
+public:
+    explicit LegacyComponentOf_(const T& v) : LegacyComponent_(ComponentTypes::Id<T>()), value(v) {}
+
+    T value;
+};
+
+class LegacyEntity_
+{
+public:
+    template<class T>
+    void Add(const T& v) { m_components.emplace_back(new LegacyComponentOf_<T>(v)); }
+
+    template<class T>
+    void Remove()
+    {
+        for (uint32 i = 0; i < m_components.size(); i++)
+        {
+            if (m_components[i]->Type() == ComponentTypes::Id<T>())
+            {
+                m_components.erase(m_components.begin() + i);
+                return;
+            }
+        }
+    }
+
+    template<class T>
+    T* Get()
+    {
+        for (auto& c : m_components)
+        {
+            if (c->Type() == ComponentTypes::Id<T>())
+                return &static_cast<LegacyComponentOf_<T>*>(c.get())->value;
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<std::unique_ptr<LegacyComponent_>> m_components;
+};
+
+typedef std::vector<std::unique_ptr<LegacyEntity_>> LegacyWorld_;
+
+static void Move_(Position_& p, const Velocity_& v, DeltaTime dt)
+{
+    p.x += v.x * dt;
+    p.y += v.y * dt;
+    p.z += v.z * dt;
+}
+
+static void Fall_(Velocity_& v, const Mass_& m, DeltaTime dt)
+{
+    v.y -= 9.8f * m.inverse * dt;
+}
+
+static void Regenerate_(Health_& h, DeltaTime dt)
+{
+    h.hp += h.regen * dt;
+}
+
+static void CreateLegacy_(LegacyWorld_& world, uint32 count)
+{
+    world.reserve(count);
+    for (uint32 i = 0; i < count; i++)
+    {
+        std::unique_ptr<LegacyEntity_> e(new LegacyEntity_);
+        e->Add(Position_{(float32)i, 0.0f, 0.0f});
+        e->Add(Velocity_{1.0f, 0.0f, 0.0f});
+        e->Add(Mass_{1.0f / (1 + i % 10)});
+        e->Add(Health_{100.0f, 0.5f});
+        world.push_back(std::move(e));
+    }
+}
+
+static void CreateEntities_(EntityManager& em, std::vector<Entity>& entities, uint32 count)
+{
+    entities.reserve(count);
+    for (uint32 i = 0; i < count; i++)
+    {
+        entities.push_back(em.Create(Position_{(float32)i, 0.0f, 0.0f}, Velocity_{1.0f, 0.0f, 0.0f},
+                                     Mass_{1.0f / (1 + i % 10)}, Health_{100.0f, 0.5f}));
+    }
+}
+
+// 2, 3 and 4 components of 1M entities that have all four.
+static void BenchIterate_()
+{
+    const DeltaTime dt = 0.016f;
+
+    {
+        LegacyWorld_ world;
+        CreateLegacy_(world, ENTITIES_);
+
+        BenchReport("Iterate 1M, 2 components, object per entity", BenchBest(5, [&]
+        {
+            for (auto& e : world)
+            {
+                Position_* p = e->Get<Position_>();
+                Velocity_* v = e->Get<Velocity_>();
+                if (p && v)
+                    Move_(*p, *v, dt);
+            }
+        }));
+
+        BenchReport("Iterate 1M, 3 components, object per entity", BenchBest(5, [&]
+        {
+            for (auto& e : world)
+            {
+                Position_* p = e->Get<Position_>();
+                Velocity_* v = e->Get<Velocity_>();
+                Mass_*     m = e->Get<Mass_>();
+                if (p && v && m)
+                {
+                    Fall_(*v, *m, dt);
+                    Move_(*p, *v, dt);
+                }
+            }
+        }));
+
+        BenchReport("Iterate 1M, 4 components, object per entity", BenchBest(5, [&]
+        {
+            for (auto& e : world)
+            {
+                Position_* p = e->Get<Position_>();
+                Velocity_* v = e->Get<Velocity_>();
+                Mass_*     m = e->Get<Mass_>();
+                Health_*   h = e->Get<Health_>();
+                if (p && v && m && h)
+                {
+                    Fall_(*v, *m, dt);
+                    Move_(*p, *v, dt);
+                    Regenerate_(*h, dt);
+                }
+            }
+        }));
+
+        benchSink_ = (uint64)world[ENTITIES_ / 2]->Get<Position_>()->x;
+    }
+
+    EntityManager em;
+    std::vector<Entity> entities;
+    CreateEntities_(em, entities, ENTITIES_);
+
+    BenchReport("Iterate 1M, 2 components, EntityManager", BenchBest(5, [&]
+    {
+        em.Each<Position_, const Velocity_>([dt](Position_& p, const Velocity_& v) { Move_(p, v, dt); });
+    }));
+
+    BenchReport("Iterate 1M, 3 components, EntityManager", BenchBest(5, [&]
+    {
+        em.Each<Position_, Velocity_, const Mass_>([dt](Position_& p, Velocity_& v, const Mass_& m)
+        {
+            Fall_(v, m, dt);
+            Move_(p, v, dt);
+        });
+    }));
+
+    BenchReport("Iterate 1M, 4 components, EntityManager", BenchBest(5, [&]
+    {
+        em.Each<Position_, Velocity_, const Mass_, Health_>([dt](Position_& p, Velocity_& v, const Mass_& m, Health_& h)
+        {
+            Fall_(v, m, dt);
+            Move_(p, v, dt);
+            Regenerate_(h, dt);
+        });
+    }));
+
+    benchSink_ = (uint64)em.Get<Position_>(entities[ENTITIES_ / 2])->x;
+}
+
+// Creating and destroying 1M entities of four components, and adding and
+// removing one.
+static void BenchCreateDestroy_()
+{
+    BenchReport("Create and destroy 1M, object per entity", BenchBest(3, []
+    {
+        LegacyWorld_ world;
+        CreateLegacy_(world, ENTITIES_);
+        world.clear();
+    }));
+
+    BenchReport("Create and destroy 1M, EntityManager", BenchBest(3, []
+    {
+        EntityManager em;
+        std::vector<Entity> entities;
+        CreateEntities_(em, entities, ENTITIES_);
+        for (Entity e : entities)
+            em.Destroy(e);
+    }));
+
+    {
+        LegacyWorld_ world;
+        CreateLegacy_(world, ENTITIES_);
+        BenchReport("Remove/add 1 of 4 components, 1M, object per entity", BenchBest(3, [&]
+        {
+            for (auto& e : world)
+                e->Remove<Velocity_>();
+            for (auto& e : world)
+                e->Add(Velocity_{1.0f, 0.0f, 0.0f});
+        }));
+    }
+
+    EntityManager em;
+    std::vector<Entity> entities;
+    CreateEntities_(em, entities, ENTITIES_);
+    BenchReport("Remove/add 1 of 4 components, 1M, EntityManager", BenchBest(3, [&]
+    {
+        for (Entity e : entities)
+            em.Remove<Velocity_>(e);
+        for (Entity e : entities)
+            em.Add<Velocity_>(e, Velocity_{1.0f, 0.0f, 0.0f});
+    }));
+}
+
+void BenchEntities()
+{
+    BenchIterate_();
+    BenchCreateDestroy_();
+}
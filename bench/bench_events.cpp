@@ -0,0 +1,214 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "global.hpp"
+#include "app.hpp"
+#include "bench.hpp"
+#include "event_bus.hpp"
+#include "events.hpp"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+// The EventBus that the type-indexed one replaced, less its time limit:
+// subscribers in a std::map of std::lists, events queued by shared_ptr in
+// another std::list.
+class LegacyEventBus_
+{
+public:
+    typedef std::shared_ptr<uint32> SubscriberIDStrongPtr;
+    typedef std::function<void(EventStrongPtr e)> Subscriber;
+
+    SubscriberIDStrongPtr Subscribe(const Subscriber& subscriber, UUID type)
+    {
+        SubscriberIDStrongPtr sid = std::make_shared<uint32>(m_nextSubscriberID++);
+        m_subscribers[type].push_back(Subscriber_{sid, subscriber});
+        return sid;
+    }
+
+    void Publish(const EventStrongPtr& event)
+    {
+        if (m_subscribers.find(event->Type()) != m_subscribers.end())
+            m_queues[m_activeQueue].push_back(event);
+    }
+
+    void Update()
+    {
+        std::list<EventStrongPtr>& q = m_queues[m_activeQueue];
+        m_activeQueue = (m_activeQueue + 1) % 2;
+        m_queues[m_activeQueue].clear();
+
+        while (!q.empty())
+        {
+            EventStrongPtr e = q.front();
+            q.pop_front();
+
+            auto findIt = m_subscribers.find(e->Type());
+            if (findIt == m_subscribers.end())
+                continue;
+
+            std::list<Subscriber_>& l = findIt->second;
+            auto it = l.begin();
+            while (it != l.end())
+            {
+                auto thisIt = it++;
+                SubscriberIDStrongPtr sid = thisIt->id.lock();
+                if (sid)
+                    thisIt->s(e);
+                else
+                    l.erase(thisIt);
+            }
+        }
+    }
+
+private:
+    struct Subscriber_
+    {
+        std::weak_ptr<uint32> id;
+        Subscriber            s;
+    };
+
+    std::map<UUID, std::list<Subscriber_>> m_subscribers;
+    std::list<EventStrongPtr>              m_queues[2];
+    uint32                                 m_activeQueue      = 0;
+    uint32                                 m_nextSubscriberID = 0;
+};
+
+// Any number of event types from one class, for publishing by pointer,
+// which only needs IEvent.
+class BenchEvent_ : public IEvent
+{
+public:
+    explicit BenchEvent_(UUID type) : m_type(type), m_index(EventTypes::IndexOf(type)) {}
+
+    UUID           Type()     const override { return m_type; }
+    EventTypeIndex Index()    const override { return m_index; }
+    const char*    Name()     const override { return "BenchEvent"; }
+    EventPriority  Priority() const override { return EventPriority::Normal; }
+
+    IEvent* MoveInto(FrameArena& a) override       { return a.New<BenchEvent_>(std::move(*this)); }
+    IEvent* CopyInto(FrameArena& a) const override { return a.New<BenchEvent_>(*this); }
+
+    const void* Payload()     const override { return &m_type; }
+    uint32      PayloadSize() const override { return sizeof(m_type); }
+
+private:
+    UUID           m_type;
+    EventTypeIndex m_index;
+};
+
+static const uint32 NUM_TYPES_        = 300;
+static const uint32 SUBSCRIBERS_      = 10; // Per type.
+static const uint32 FRAMES_           = 1000;
+static const uint32 EVENTS_PER_FRAME_ = 1000;
+static const UUID   FIRST_TYPE_       = 0xBE000000;
+
+// Spread over the types in an order that defeats the branch predictor.
+static uint32 TypeOf_(uint32 event) { return (event * 7919) % NUM_TYPES_; }
+
+static void BenchDispatch_()
+{
+    std::vector<EventStrongPtr> events;
+    for (uint32 t = 0; t < NUM_TYPES_; t++)
+        events.push_back(std::make_shared<BenchEvent_>(FIRST_TYPE_ + t));
+
+    uint64 sum = 0;
+    auto handler = [&sum](EventStrongPtr e) { sum += e->Type(); };
+
+    LegacyEventBus_ legacy;
+    std::vector<LegacyEventBus_::SubscriberIDStrongPtr> legacyIDs;
+    for (uint32 t = 0; t < NUM_TYPES_; t++)
+    {
+        for (uint32 s = 0; s < SUBSCRIBERS_; s++)
+            legacyIDs.push_back(legacy.Subscribe(handler, FIRST_TYPE_ + t));
+    }
+
+    EventBus bus;
+    bus.SetMetricsEnabled(false);
+    std::vector<EventBus::Subscription> subscriptions;
+    for (uint32 t = 0; t < NUM_TYPES_; t++)
+    {
+        for (uint32 s = 0; s < SUBSCRIBERS_; s++)
+            subscriptions.push_back(bus.Subscribe([&sum](IEvent& e) { sum += e.Type(); }, FIRST_TYPE_ + t));
+    }
+
+    BenchReport("1M dispatches, 300 types x 10 subs, std::map/list", BenchBest(3, [&]
+    {
+        for (uint32 f = 0; f < FRAMES_; f++)
+        {
+            for (uint32 i = 0; i < EVENTS_PER_FRAME_; i++)
+                legacy.Publish(events[TypeOf_(i)]);
+            legacy.Update();
+        }
+    }));
+
+    BenchReport("1M dispatches, 300 types x 10 subs, EventBus", BenchBest(3, [&]
+    {
+        for (uint32 f = 0; f < FRAMES_; f++)
+        {
+            for (uint32 i = 0; i < EVENTS_PER_FRAME_; i++)
+                bus.Publish(events[TypeOf_(i)]);
+            bus.Update();
+        }
+    }));
+
+    benchSink_ = sum;
+}
+
+// The typed path: events built in the frame arena, handlers called without
+// std::function or a cast.
+static void BenchTypedDispatch_()
+{
+    uint64 sum = 0;
+
+    LegacyEventBus_ legacy;
+    std::vector<LegacyEventBus_::SubscriberIDStrongPtr> legacyIDs;
+    for (uint32 s = 0; s < SUBSCRIBERS_; s++)
+    {
+        legacyIDs.push_back(legacy.Subscribe([&sum](EventStrongPtr e)
+        {
+            sum += std::static_pointer_cast<EventRotateCamera>(e)->xrel;
+        }, EventRotateCamera::TYPE));
+    }
+
+    EventBus bus;
+    bus.SetMetricsEnabled(false);
+    std::vector<EventBus::Subscription> subscriptions;
+    for (uint32 s = 0; s < SUBSCRIBERS_; s++)
+        subscriptions.push_back(bus.Subscribe<EventRotateCamera>([&sum](const EventRotateCamera& e) { sum += e.xrel; }));
+
+    BenchReport("1M dispatches, 1 type x 10 subs, std::map/list", BenchBest(3, [&]
+    {
+        for (uint32 f = 0; f < FRAMES_; f++)
+        {
+            for (uint32 i = 0; i < EVENTS_PER_FRAME_ / SUBSCRIBERS_; i++)
+                legacy.Publish(std::make_shared<EventRotateCamera>((int32)i, 0));
+            legacy.Update();
+        }
+    }));
+
+    BenchReport("1M dispatches, 1 type x 10 subs, EventBus::Publish<T>", BenchBest(3, [&]
+    {
+        for (uint32 f = 0; f < FRAMES_; f++)
+        {
+            for (uint32 i = 0; i < EVENTS_PER_FRAME_ / SUBSCRIBERS_; i++)
+                bus.Publish<EventRotateCamera>((int32)i, 0);
+            bus.Update();
+        }
+    }));
+
+    benchSink_ = sum;
+}
+
+void BenchEvents()
+{
+    BenchDispatch_();
+    BenchTypedDispatch_();
+}
@@ -0,0 +1,199 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "global.hpp"
+#include "app.hpp"
+#include "bench.hpp"
+#include "process_manager.hpp"
+#include "thread_pool.hpp"
+
+#include <list>
+#include <memory>
+
+static const uint32 PROCESSES_ = 100000;
+static const uint32 UPDATES_   = 100;
+
+// The ProcessManager that the pooled, contiguous one replaced: processes
+// from std::make_shared in a std::list, attached with push_front().
+class LegacyProcess_
+{
+public:
+    enum class State { Uninitialized, Running, Succeeded, Failed };
+
+    virtual ~LegacyProcess_() {}
+
+    State State()  const { return m_state; }
+    bool  IsDead() const { return (m_state == State::Succeeded || m_state == State::Failed); }
+    void  Succeed() { m_state = State::Succeeded; }
+
+    virtual void OnInit() { m_state = State::Running; }
+    virtual void OnUpdate(DeltaTime dt) = 0;
+    virtual void OnSuccess() {}
+    virtual void OnFail()    {}
+
+private:
+    enum State m_state = State::Uninitialized;
+};
+
+class LegacyProcessManager_
+{
+public:
+    void Attach(std::shared_ptr<LegacyProcess_> p) { m_processes.push_front(std::move(p)); }
+
+    void Update(DeltaTime dt)
+    {
+        m_lastSuccessCount = 0;
+
+        auto it = m_processes.begin();
+        while (it != m_processes.end())
+        {
+            std::shared_ptr<LegacyProcess_> p = *it;
+            auto thisIt = it++;
+
+            if (p->State() == LegacyProcess_::State::Uninitialized)
+                p->OnInit();
+            if (p->State() == LegacyProcess_::State::Running)
+                p->OnUpdate(dt);
+
+            if (p->IsDead())
+            {
+                if (p->State() == LegacyProcess_::State::Succeeded)
+                {
+                    p->OnSuccess();
+                    m_lastSuccessCount++;
+                }
+                else
+                {
+                    p->OnFail();
+                }
+                m_processes.erase(thisIt);
+            }
+        }
+    }
+
+    uint32 LastSuccessCount() const { return m_lastSuccessCount; }
+
+private:
+    std::list<std::shared_ptr<LegacyProcess_>> m_processes;
+    uint32                                     m_lastSuccessCount = 0;
+};
+
+// A few dozen nanoseconds of work, so dispatch overhead is what's measured.
+static uint32 Work_(uint32 x, uint32 iterations)
+{
+    for (uint32 i = 0; i < iterations; i++)
+        x = x * 1664525u + 1013904223u;
+    return x;
+}
+
+// Succeeds after life updates.
+class LegacyCounter_ : public LegacyProcess_
+{
+public:
+    explicit LegacyCounter_(uint32 life) : m_life(life) {}
+
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        m_x = Work_(m_x, 8);
+        if (--m_life == 0)
+            Succeed();
+    }
+
+private:
+    uint32 m_life;
+    uint32 m_x = 1;
+};
+
+class Counter_ : public Process
+{
+public:
+    Counter_(uint32 life, uint32 iterations) : m_life(life), m_iterations(iterations) {}
+
+protected:
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        m_x = Work_(m_x, m_iterations);
+        if (--m_life == 0)
+            Succeed();
+    }
+
+private:
+    uint32 m_life;
+    uint32 m_iterations;
+    uint32 m_x = 1;
+};
+
+// Processes live 1 to 64 updates and are replaced as they succeed, so the
+// list is shuffled through the heap the way a running game's is.
+static void BenchUpdate_()
+{
+    LegacyProcessManager_ legacy;
+    uint32 legacySpawned = 0;
+    for (; legacySpawned < PROCESSES_; legacySpawned++)
+        legacy.Attach(std::make_shared<LegacyCounter_>(1 + legacySpawned % 64));
+
+    ProcessManager pm;
+    uint32 spawned = 0;
+    for (; spawned < PROCESSES_; spawned++)
+        pm.Spawn<Counter_>(1 + spawned % 64, 8);
+
+    BenchReport("Update(), 100k churning, std::list/make_shared", BenchBest(3, [&]
+    {
+        for (uint32 u = 0; u < UPDATES_; u++)
+        {
+            legacy.Update(1.0f);
+            for (uint32 n = legacy.LastSuccessCount(); n > 0; n--, legacySpawned++)
+                legacy.Attach(std::make_shared<LegacyCounter_>(1 + legacySpawned % 64));
+        }
+    }) / UPDATES_);
+
+    BenchReport("Update(), 100k churning, ProcessManager", BenchBest(3, [&]
+    {
+        for (uint32 u = 0; u < UPDATES_; u++)
+        {
+            pm.Update(1.0f);
+            for (uint32 n = pm.LastSuccessCount(); n > 0; n--, spawned++)
+                pm.Spawn<Counter_>(1 + spawned % 64, 8);
+        }
+    }) / UPDATES_);
+}
+
+// The same heavier processes on the main thread, then on the pool.
+static void BenchConcurrentDispatch_()
+{
+    ThreadPool pool;
+    ProcessManager mainThread;
+    ProcessManager concurrent;
+    concurrent.SetThreadPool(&pool);
+    for (uint32 i = 0; i < PROCESSES_; i++)
+    {
+        mainThread.Spawn<Counter_>(~0u, 200);
+        Process::StrongPtr p = ProcessManager::Create<Counter_>(~0u, 200);
+        p->SetDispatch(ProcessDispatch::Concurrent);
+        concurrent.Attach(p);
+    }
+
+    BenchReport("Update(), 100k heavier, MainThread", BenchBest(3, [&]
+    {
+        for (uint32 u = 0; u < UPDATES_ / 10; u++)
+            mainThread.Update(1.0f);
+    }) / (UPDATES_ / 10));
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "Update(), 100k heavier, Concurrent on %u threads", pool.NumThreads() + 1);
+    BenchReport(name, BenchBest(3, [&]
+    {
+        for (uint32 u = 0; u < UPDATES_ / 10; u++)
+            concurrent.Update(1.0f);
+    }) / (UPDATES_ / 10));
+}
+
+void BenchProcesses()
+{
+    BenchUpdate_();
+    BenchConcurrentDispatch_();
+}
@@ -0,0 +1,61 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+// ellie-bench: micro-benchmarks of the engine's hot paths, each against the
+// design it replaced where there was one.
+//
+//     ellie-bench [area]
+//
+// Runs every area, or only the one named. Build with
+// -DCMAKE_BUILD_TYPE=Release, or the numbers mean little.
+
+#include "global.hpp"
+#include "app.hpp"
+#include "bench.hpp"
+
+#include <cstdio>
+#include <cstring> // strcmp
+
+App& App::Get()
+{
+    static App app;
+    return app;
+}
+
+struct BenchArea_
+{
+    const char* name;
+    void (*run)();
+};
+
+static const BenchArea_ areas_[] =
+{
+    {"events",    &BenchEvents},
+    {"processes", &BenchProcesses},
+    {"entities",  &BenchEntities},
+};
+
+int main(int argc, char* argv[])
+{
+    const char* only = (argc > 1 ? argv[1] : nullptr);
+    bool ran = false;
+    for (const BenchArea_& a : areas_)
+    {
+        if (only && std::strcmp(only, a.name) != 0)
+            continue;
+        std::printf("%s:\n", a.name);
+        a.run();
+        ran = true;
+    }
+
+    if (!ran)
+    {
+        std::printf("Unknown area: %s.\n", only);
+        return 1;
+    }
+    return 0;
+}
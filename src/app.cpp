@@ -6,8 +6,10 @@
 */
 
 #include "app.hpp"
+#include "async_file.hpp"
 #include "event_bus.hpp"
 #include "logic.hpp"
+#include "thread_pool.hpp"
 #include "view_interface.hpp"
 #include "view_opengl.hpp"
 
@@ -115,12 +117,49 @@ bool App::Init()
     m_options.core.shaderPath  = m_options.core.dataPath + "shaders" + PATH_SEPARATOR;
     m_options.core.texturePath = m_options.core.dataPath + "textures" + PATH_SEPARATOR;
 
+    m_workers = new (std::nothrow) ThreadPool(m_options.threads.workers);
+    if (!m_workers)
+    {
+        LogFatal("Failed to allocate memory for thread pool.");
+        return false;
+    }
+    LogInfo("Started %u worker threads.", m_workers->NumThreads());
+
+    m_files = new (std::nothrow) AsyncFileReader;
+    if (!m_files)
+    {
+        LogFatal("Failed to allocate memory for file reader.");
+        return false;
+    }
+    else if (!m_files->Init(64, m_options.threads.fileReaders))
+    {
+        return false;
+    }
+
+    if (EventTypes::CollisionCount() > 0)
+    {
+        LogFatal("Event type IDs collide; rename the events above.");
+        return false;
+    }
+    LogInfo("Registered %u event types.", EventTypes::Count());
+
     m_events = new (std::nothrow) EventBus;
     if (!m_events)
     {
         LogFatal("Failed to allocate memory for event bus.");
         return false;
     }
+    m_events->SetThreadPool(m_workers);
+    m_events->SetQueueLimits(EventPriority::Critical,   m_options.events.queueCapacity, EventOverflowPolicy::Block);
+    m_events->SetQueueLimits(EventPriority::Normal,     m_options.events.queueCapacity, m_options.events.overflowPolicy);
+    m_events->SetQueueLimits(EventPriority::Deferrable, m_options.events.queueCapacity, m_options.events.overflowPolicy);
+    m_events->SetThreadSafeCapacity(m_options.events.threadSafeCapacity);
+    if (!m_options.events.replayFile.empty())
+        m_events->StartReplay(m_options.core.savePath + m_options.events.replayFile, m_options.events.replayLoop);
+    else if (!m_options.events.recordFile.empty())
+        m_events->StartRecording(m_options.core.savePath + m_options.events.recordFile);
+    if (!m_options.events.tapName.empty())
+        m_events->StartTap(m_options.events.tapName);
 
     m_logic = new (std::nothrow) class Logic;
     if (!m_logic)
@@ -168,16 +207,36 @@ void App::Cleanup()
 
     if (m_events)
     {
+        if (!m_options.core.savePath.empty())
+            m_events->DumpMetrics(m_options.core.savePath + "event_metrics.txt");
         delete m_events;
         m_events = nullptr;
     }
 
+    if (m_files)
+    {
+        m_files->Cleanup();
+        delete m_files;
+        m_files = nullptr;
+    }
+
+    if (m_workers)
+    {
+        delete m_workers;
+        m_workers = nullptr;
+    }
+
     SDL_Quit();
     ForceSingleInstanceCleanup_();
 }
 
 int App::Loop()
 {
+    EventBudget eventBudget(m_options.events.targetFrameRate,
+                            m_options.events.budgetMin,
+                            m_options.events.budgetMaxFraction);
+    m_events->SetShedding(m_options.events.shedPolicy, m_options.events.backlogLimit);
+
     TimeStamp dtNow = Time();
     TimeStamp dtLast;
     DeltaTime dt;
@@ -187,11 +246,12 @@ int App::Loop()
         dtNow = Time();
         dt = App::MillisecondsBetween(dtLast, dtNow);
 
+        eventBudget.Update(dt, m_events->BacklogDepth());
+        m_files->Poll();
+
         if (!m_view->ProcessEvents(dt))
             break;
-        // @todo Dynamically adjust timelimit and or drop events if needed to
-        //       maintain framerate and avoid the backlog growing forever.
-        m_events->Update(true, 1000.0f/30.0f/2.0f);
+        m_events->Update(true, eventBudget.Milliseconds());
 
         if (!m_logic->Update(dt))
             break;
@@ -9,14 +9,17 @@
 #define APP_HPP
 
 #include "global.hpp"
+#include "event_budget.hpp"
 
 #include <glm/glm.hpp>
 
 #include <string>
 
+class AsyncFileReader;
 class EventBus;
 class IView;
 class Logic;
+class ThreadPool;
 
 class App {
 public:
@@ -56,6 +59,31 @@ public:
             std::string texturePath;
         } core;
 
+        struct Events {
+            // The time EventBus::Update() gets each frame is adjusted to keep
+            // frames near targetFrameRate, between budgetMin milliseconds and
+            // budgetMaxFraction of a frame.
+            float32   targetFrameRate   = 60.0f;
+            DeltaTime budgetMin         = 1.0f;
+            float32   budgetMaxFraction = 0.5f;
+
+            EventShedPolicy shedPolicy   = EventShedPolicy::DropOldest;
+            uint32          backlogLimit = 4096;
+
+            // Per priority queue, except Critical's which always Blocks.
+            uint32              queueCapacity      = 8192;
+            EventOverflowPolicy overflowPolicy     = EventOverflowPolicy::DropOldest;
+            uint32              threadSafeCapacity = 0; // 0 for no limit.
+
+            // See EventBus::StartRecording()/StartReplay(); relative to savePath.
+            std::string recordFile;
+            std::string replayFile;
+            bool        replayLoop = false;
+
+            // Shared memory name for EventBus::StartTap(); empty for none.
+            std::string tapName;
+        } events;
+
         struct Graphics {
             bool   multisampling = true;
             uint32 multisamplingNumSamples = 4; // 2 or 4.
@@ -69,12 +97,31 @@ public:
             uint32 windowWidth  = 800;
             uint32 windowHeight = 600;
         } graphics;
+
+        struct Processes {
+            // Milliseconds a frame's Normal and Background processes get in
+            // Logic and the view; 0 for no limit.
+            DeltaTime logicBudget = 0.0f;
+            DeltaTime viewBudget  = 0.0f;
+
+            // Times every OnUpdate() and logs each manager's metricsTopCount
+            // longest with the FPS, once a second.
+            bool   metrics         = false;
+            uint32 metricsTopCount = 5;
+        } processes;
+
+        struct Threads {
+            uint32 workers     = 0; // 0: one per core, less the main thread.
+            uint32 fileReaders = 2; // Only used when io_uring isn't available.
+        } threads;
     } m_options;
 
     static App& Get();
 
-    EventBus*     Events() { return m_events; }
-    class Logic*  Logic()  { return m_logic; }
+    EventBus*        Events()  { return m_events; }
+    AsyncFileReader* Files()   { return m_files; }
+    class Logic*     Logic()   { return m_logic; }
+    ThreadPool*      Workers() { return m_workers; }
 
     // Current value from the high-res counter.
     static TimeStamp Time() { return SDL_GetPerformanceCounter(); }
@@ -86,6 +133,7 @@ public:
     static DeltaTime MillisecondsElapsed(TimeStamp start) { return MillisecondsBetween(start, Time()); }
 
     static bool FolderExists(std::string folder);
+    // Blocks until the whole file is read; see Files() for reads that don't.
     static bool LoadFile(std::string file, std::string& contents);
 
     bool Init();
@@ -93,9 +141,11 @@ public:
     int  Loop(); // Returns main() return code.
 
 private:
-    EventBus*    m_events = nullptr;
-    class Logic* m_logic  = nullptr;
-    IView*       m_view   = nullptr;
+    ThreadPool*      m_workers = nullptr;
+    AsyncFileReader* m_files   = nullptr;
+    EventBus*        m_events  = nullptr;
+    class Logic*     m_logic   = nullptr;
+    IView*           m_view    = nullptr;
 
     // Creation by App::Get() only.
     App() {};
@@ -0,0 +1,451 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "async_file.hpp"
+
+#include <algorithm> // find
+#include <cstdio> // fopen/fread/fclose
+#include <thread> // this_thread
+
+bool AsyncFileReader::Init(uint32 queueDepth, uint32 threads)
+{
+    Cleanup();
+
+    if (InitIoUring_(queueDepth))
+    {
+        LogInfo("Reading files with io_uring.");
+        return true;
+    }
+
+    m_pool.reset(new (std::nothrow) ThreadPool(threads ? threads : 1));
+    if (!m_pool)
+    {
+        LogFatal("Failed to allocate memory for file reader threads.");
+        return false;
+    }
+    LogInfo("Reading files on %u threads.", m_pool->NumThreads());
+    return true;
+}
+
+void AsyncFileReader::Cleanup()
+{
+    if (UsingIoUring())
+    {
+        while (InFlight() > 0)
+            Reap_(true);
+        CleanupIoUring_();
+        m_slots.clear();
+        m_freeSlots.clear();
+    }
+    if (m_pool)
+    {
+        m_pool->Wait(m_tasks);
+        m_pool.reset();
+    }
+}
+
+bool AsyncFileReader::Submit(RequestPtr r)
+{
+    if (!r || (!m_pool && !UsingIoUring()))
+        return false;
+
+    r->m_bytesRead = 0;
+    r->m_succeeded = false;
+    r->m_fd        = -1;
+    r->m_done.store(false, std::memory_order_relaxed);
+    r->m_cancelled.store(false, std::memory_order_relaxed);
+    m_inFlight.fetch_add(1, std::memory_order_acq_rel);
+
+    if (!UsingIoUring())
+    {
+        // A task left over from a cancelled submission of r has an older
+        // ticket, so it can't claim this one.
+        if (++m_lastTicket == 0)
+            m_lastTicket = 1;
+        uint32 ticket = m_lastTicket;
+        r->m_ticket.store(ticket, std::memory_order_release);
+        m_pool->Submit(m_tasks, [this, r, ticket]()
+        {
+            uint32 expected = ticket;
+            if (!r->m_ticket.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+                return; // Cancel() completed it.
+            ReadBlocking_(*r);
+            r->m_done.store(true, std::memory_order_release);
+            m_inFlight.fetch_sub(1, std::memory_order_acq_rel);
+        });
+        return true;
+    }
+
+    uint32 slot;
+    if (m_freeSlots.empty())
+    {
+        slot = (uint32)m_slots.size();
+        m_slots.push_back({});
+    }
+    else
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    m_slots[slot].request = std::move(r);
+    m_slots[slot].step    = Step_::Open;
+
+    // Keep the order requests were submitted in.
+    if (!m_unsubmitted.empty() || !QueueStep_(slot))
+        m_unsubmitted.push_back(slot);
+    Enter_(false);
+    return true;
+}
+
+void AsyncFileReader::Poll()
+{
+    if (UsingIoUring())
+        Reap_(false);
+}
+
+void AsyncFileReader::Cancel(const RequestPtr& r)
+{
+    if (!r || r->Done())
+        return;
+    r->m_cancelled.store(true, std::memory_order_release);
+
+    if (!UsingIoUring())
+    {
+        // Still queued: complete it here, and its task does nothing.
+        if (r->m_ticket.exchange(0, std::memory_order_acq_rel) != 0)
+        {
+            r->m_done.store(true, std::memory_order_release);
+            m_inFlight.fetch_sub(1, std::memory_order_acq_rel);
+            return;
+        }
+
+        // A read under way can't be interrupted.
+        while (!r->Done())
+            std::this_thread::yield();
+        return;
+    }
+
+    uint32 slot = 0;
+    while (slot < m_slots.size() && m_slots[slot].request != r)
+        slot++;
+    if (slot == m_slots.size())
+        return; // Never submitted.
+
+    // Nothing's in the kernel while a step waits for room; the file's closed
+    // if it was opened.
+    auto waiting = std::find(m_unsubmitted.begin(), m_unsubmitted.end(), slot);
+    if (waiting == m_unsubmitted.end())
+    {
+        QueueCancel_(slot);
+    }
+    else if (m_slots[slot].step == Step_::Open)
+    {
+        m_unsubmitted.erase(waiting);
+        Complete_(slot, false);
+        return;
+    }
+    else
+    {
+        m_slots[slot].step = Step_::Close;
+        r->m_succeeded     = false;
+    }
+
+    while (!r->Done())
+        Reap_(true);
+}
+
+void AsyncFileReader::Complete_(uint32 slot, bool succeeded)
+{
+    Slot_& s = m_slots[slot];
+    s.request->m_succeeded = succeeded;
+    s.request->m_fd        = -1;
+    s.request->m_done.store(true, std::memory_order_release);
+    s.request.reset();
+    m_freeSlots.push_back(slot);
+    m_inFlight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void AsyncFileReader::ReadBlocking_(Request& r)
+{
+    if (r.m_cancelled.load(std::memory_order_acquire))
+        return;
+
+    std::FILE* f = std::fopen(r.m_file.c_str(), "rb");
+    if (!f)
+        return;
+
+    // fseek() takes a long, which is 32 bits on Windows.
+    #if defined(OS_WINDOWS)
+        bool seeked = (r.m_offset == 0 || _fseeki64(f, (__int64)r.m_offset, SEEK_SET) == 0);
+    #elif defined(OS_LINUX)
+        bool seeked = (r.m_offset == 0 || fseeko(f, (off_t)r.m_offset, SEEK_SET) == 0);
+    #else
+        #error Unknown OS.
+    #endif // OS_WINDOWS
+    if (seeked)
+    {
+        r.m_bytesRead = std::fread(r.m_buffer, 1, r.m_capacity, f);
+        r.m_succeeded = !std::ferror(f);
+    }
+    std::fclose(f);
+}
+
+#if defined(OS_WINDOWS)
+
+    // @todo Overlapped ReadFile() or an I/O completion port.
+
+    bool AsyncFileReader::InitIoUring_(uint32 /*queueDepth*/) { return false; }
+    void AsyncFileReader::CleanupIoUring_() {}
+    void AsyncFileReader::Reap_(bool /*wait*/) {}
+    void AsyncFileReader::Advance_(uint32 /*slot*/, int32 /*result*/) {}
+    bool AsyncFileReader::QueueStep_(uint32 /*slot*/) { return false; }
+    void AsyncFileReader::QueueCancel_(uint32 /*slot*/) {}
+    void AsyncFileReader::Enter_(bool /*wait*/) {}
+
+#elif defined(OS_LINUX)
+
+    // Raw syscalls rather than liburing, which isn't worth a dependency for
+    // three opcodes; see io_uring(7) for the ring protocol.
+    #include <fcntl.h> // AT_FDCWD/O_*
+    #include <linux/io_uring.h>
+    #include <sys/mman.h> // mmap/munmap
+    #include <sys/syscall.h> // __NR_io_uring_*
+    #include <unistd.h> // close/syscall
+
+    // Largest single read; the kernel caps one at about 2GB anyway.
+    static const uint64 MAX_READ_ = 1ull << 30;
+
+    // user_data of QueueCancel_()'s entries; slots' are 32 bits.
+    static const uint64 CANCEL_USER_DATA_ = ~0ull;
+
+    bool AsyncFileReader::InitIoUring_(uint32 queueDepth)
+    {
+        io_uring_params p;
+        ZERO_STRUCT(p);
+        int fd = (int)syscall(__NR_io_uring_setup, queueDepth, &p);
+        if (fd < 0)
+            return false; // Too old, or disabled by seccomp/sysctl.
+        // OPENAT/CLOSE arrived in 5.6 without a feature bit of their own;
+        // FAST_POLL (5.7) is the nearest one that implies them.
+        if (!(p.features & IORING_FEAT_FAST_POLL))
+        {
+            close(fd);
+            return false;
+        }
+
+        m_ringFd     = fd;
+        m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(uint32);
+        m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        m_sqesSize   = p.sq_entries * sizeof(io_uring_sqe);
+        bool single  = (p.features & IORING_FEAT_SINGLE_MMAP);
+        if (single)
+            m_sqRingSize = m_cqRingSize = (m_sqRingSize > m_cqRingSize ? m_sqRingSize : m_cqRingSize);
+
+        void* sq = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        void* cq = (single ? sq : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        m_sqRing = (sq   == MAP_FAILED ? nullptr : sq);
+        m_cqRing = (cq   == MAP_FAILED ? nullptr : cq);
+        m_sqes   = (sqes == MAP_FAILED ? nullptr : sqes);
+        if (!m_sqRing || !m_cqRing || !m_sqes)
+        {
+            LogWarning("Failed to map io_uring's rings.");
+            CleanupIoUring_();
+            return false;
+        }
+
+        uint8* s = (uint8*)m_sqRing;
+        m_sqHead    = (uint32*)(s + p.sq_off.head);
+        m_sqTail    = (uint32*)(s + p.sq_off.tail);
+        m_sqMask    = (uint32*)(s + p.sq_off.ring_mask);
+        m_sqArray   = (uint32*)(s + p.sq_off.array);
+        m_sqEntries = p.sq_entries;
+        uint8* c = (uint8*)m_cqRing;
+        m_cqHead    = (uint32*)(c + p.cq_off.head);
+        m_cqTail    = (uint32*)(c + p.cq_off.tail);
+        m_cqMask    = (uint32*)(c + p.cq_off.ring_mask);
+        m_cqes      = c + p.cq_off.cqes;
+        return true;
+    }
+
+    void AsyncFileReader::CleanupIoUring_()
+    {
+        if (m_sqes)
+            munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing)
+            munmap(m_sqRing, m_sqRingSize);
+        if (m_ringFd != -1)
+            close(m_ringFd);
+
+        m_ringFd = -1;
+        m_sqRing = m_cqRing = m_sqes = m_cqes = nullptr;
+        m_sqHead = m_sqTail = m_sqMask = m_sqArray = nullptr;
+        m_cqHead = m_cqTail = m_cqMask = nullptr;
+        m_unsubmitted.clear();
+        m_queued = m_toSubmit = 0;
+    }
+
+    void AsyncFileReader::Reap_(bool wait)
+    {
+        Enter_(wait);
+
+        uint32 head = *m_cqHead; // Only we write it.
+        uint32 tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            const io_uring_cqe& cqe = ((const io_uring_cqe*)m_cqes)[head & *m_cqMask];
+            uint64 data   = cqe.user_data;
+            int32  result = cqe.res;
+            head++;
+            m_queued--;
+            // Frees the entry before Advance_() queues the next step.
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+            if (data != CANCEL_USER_DATA_)
+                Advance_((uint32)data, result);
+        }
+
+        // Retry what didn't fit now there may be room.
+        uint64 i = 0;
+        while (i < m_unsubmitted.size() && QueueStep_(m_unsubmitted[i]))
+            i++;
+        m_unsubmitted.erase(m_unsubmitted.begin(), m_unsubmitted.begin() + i);
+
+        Enter_(false);
+    }
+
+    void AsyncFileReader::Advance_(uint32 slot, int32 result)
+    {
+        Slot_&   s = m_slots[slot];
+        Request& r = *s.request;
+
+        switch (s.step)
+        {
+        case Step_::Open:
+            if (result < 0)
+            {
+                Complete_(slot, false);
+                return;
+            }
+            r.m_fd = result;
+            s.step = (r.m_capacity > 0 ? Step_::Read : Step_::Close);
+            r.m_succeeded = (r.m_capacity == 0);
+            break;
+
+        case Step_::Read:
+            if (result > 0)
+                r.m_bytesRead += (uint64)result;
+            // Short reads only mean the file ended when they return 0.
+            if (result < 0 || result == 0 || r.m_bytesRead >= r.m_capacity)
+            {
+                r.m_succeeded = (result >= 0);
+                s.step        = Step_::Close;
+            }
+            break;
+
+        case Step_::Close:
+            Complete_(slot, r.m_succeeded);
+            return;
+        }
+
+        // Straight to closing the file once cancelled.
+        if (s.step == Step_::Read && r.m_cancelled.load(std::memory_order_relaxed))
+        {
+            s.step        = Step_::Close;
+            r.m_succeeded = false;
+        }
+
+        if (!m_unsubmitted.empty() || !QueueStep_(slot))
+            m_unsubmitted.push_back(slot);
+    }
+
+    bool AsyncFileReader::QueueStep_(uint32 slot)
+    {
+        // Never more in flight than the queue holds, so the completion queue
+        // (twice its size) can't overflow.
+        if (m_queued >= m_sqEntries)
+            return false;
+
+        uint32 tail  = *m_sqTail; // Only we write it.
+        uint32 index = tail & *m_sqMask;
+        io_uring_sqe& sqe = ((io_uring_sqe*)m_sqes)[index];
+        ZERO_STRUCT(sqe);
+
+        Slot_&   s = m_slots[slot];
+        Request& r = *s.request;
+        switch (s.step)
+        {
+        case Step_::Open:
+            sqe.opcode     = IORING_OP_OPENAT;
+            sqe.fd         = AT_FDCWD;
+            sqe.addr       = (uint64)r.m_file.c_str();
+            sqe.open_flags = O_RDONLY | O_CLOEXEC;
+            break;
+
+        case Step_::Read:
+        {
+            uint64 remaining = r.m_capacity - r.m_bytesRead;
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd     = r.m_fd;
+            sqe.addr   = (uint64)(r.m_buffer + r.m_bytesRead);
+            sqe.len    = (uint32)(remaining < MAX_READ_ ? remaining : MAX_READ_);
+            sqe.off    = r.m_offset + r.m_bytesRead;
+            break;
+        }
+
+        case Step_::Close:
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd     = r.m_fd;
+            break;
+        }
+        sqe.user_data = slot;
+
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        m_queued++;
+        m_toSubmit++;
+        return true;
+    }
+
+    // Cancels the step slot has in flight; its completion, or the
+    // cancellation's error, then goes through Advance_() as usual.
+    void AsyncFileReader::QueueCancel_(uint32 slot)
+    {
+        while (m_queued >= m_sqEntries)
+            Reap_(true);
+
+        uint32 tail  = *m_sqTail;
+        uint32 index = tail & *m_sqMask;
+        io_uring_sqe& sqe = ((io_uring_sqe*)m_sqes)[index];
+        ZERO_STRUCT(sqe);
+        sqe.opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe.addr      = slot;
+        sqe.user_data = CANCEL_USER_DATA_;
+
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        m_queued++;
+        m_toSubmit++;
+        Enter_(false);
+    }
+
+    void AsyncFileReader::Enter_(bool wait)
+    {
+        wait = (wait && m_queued > 0);
+        if (m_toSubmit == 0 && !wait)
+            return;
+
+        uint32 flags = (wait ? IORING_ENTER_GETEVENTS : 0);
+        int submitted = (int)syscall(__NR_io_uring_enter, m_ringFd, m_toSubmit, (wait ? 1 : 0), flags, nullptr, 0);
+        if (submitted > 0)
+            m_toSubmit -= (uint32)submitted;
+    }
+
+#else
+    #error Unknown OS.
+#endif // OS_WINDOWS
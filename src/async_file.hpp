@@ -0,0 +1,195 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef ASYNC_FILE_HPP
+#define ASYNC_FILE_HPP
+
+// Reads files into caller-provided buffers without blocking the main thread:
+// through io_uring on Linux 5.7 or later, when the kernel allows it, and on
+// threads of its own otherwise, so blocking reads never hold up App::Workers()
+// or whoever is waiting on them. Open, read and close are all queued, so the
+// main thread only pays for submitting and reaping.
+
+#include "global.hpp"
+#include "process_manager.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory> // shared_ptr/unique_ptr
+#include <string>
+#include <vector>
+
+class AsyncFileReader
+{
+public:
+    // One read; Submit() holds a reference until it's done, so dropping a
+    // request early is safe, but its buffer must outlive the read; see
+    // Cancel().
+    class Request
+    {
+    public:
+        Request(std::string file, void* buffer, uint64 capacity, uint64 offset = 0)
+            : m_file(std::move(file)), m_buffer((uint8*)buffer), m_capacity(capacity), m_offset(offset) {}
+
+        const std::string& File() const { return m_file; }
+
+        // The rest are only meaningful once Done().
+        bool   Done()      const { return m_done.load(std::memory_order_acquire); }
+        bool   Succeeded() const { return m_succeeded; }
+        // Less than the capacity if the file ended first.
+        uint64 BytesRead() const { return m_bytesRead; }
+
+    private:
+        friend class AsyncFileReader;
+
+        std::string m_file;
+        uint8*      m_buffer;
+        uint64      m_capacity;
+        uint64      m_offset;
+        uint64      m_bytesRead = 0;
+        bool        m_succeeded = false;
+        int         m_fd        = -1;
+        std::atomic<bool> m_done{false};
+        std::atomic<bool> m_cancelled{false};
+        // Without io_uring, the submission's ticket until a thread or
+        // Cancel() claims it; then 0.
+        std::atomic<uint32> m_ticket{0};
+    };
+
+    typedef std::shared_ptr<Request> RequestPtr;
+
+    ~AsyncFileReader() { Cleanup(); }
+
+    // queueDepth is io_uring's submission queue size; threads run the reads
+    // when io_uring isn't available.
+    bool Init(uint32 queueDepth = 64, uint32 threads = 2);
+    // Waits for the reads in flight.
+    void Cleanup();
+
+    bool UsingIoUring() const { return m_ringFd != -1; }
+
+    // Returns false if r couldn't be queued.
+    // @warning Main thread only, like Poll() and Cancel().
+    bool Submit(RequestPtr r);
+
+    // Stops r early, if it's still in flight, and returns once nothing will
+    // touch its buffer again; it's done then, but hasn't succeeded unless it
+    // finished first. Without io_uring, a read still queued for a thread is
+    // completed at once, and only one already under way is waited for.
+    void Cancel(const RequestPtr& r);
+
+    // Moves io_uring reads along and completes the finished ones; cheap when
+    // nothing has finished. Call once a frame.
+    void Poll();
+
+    // Submitted and not yet done.
+    uint32 InFlight() const { return m_inFlight.load(std::memory_order_acquire); }
+
+private:
+    std::unique_ptr<ThreadPool> m_pool; // Only without io_uring.
+    ThreadPool::TaskGroup       m_tasks;
+    uint32                      m_lastTicket = 0;
+    std::atomic<uint32>   m_inFlight{0};
+
+    // io_uring; see async_file.cpp.
+    int     m_ringFd    = -1;
+    void*   m_sqRing    = nullptr;
+    void*   m_cqRing    = nullptr;
+    void*   m_sqes      = nullptr;
+    uint64  m_sqRingSize = 0;
+    uint64  m_cqRingSize = 0;
+    uint64  m_sqesSize   = 0;
+    uint32* m_sqHead    = nullptr;
+    uint32* m_sqTail    = nullptr;
+    uint32* m_sqMask    = nullptr;
+    uint32* m_sqArray   = nullptr;
+    uint32  m_sqEntries = 0;
+    uint32* m_cqHead    = nullptr;
+    uint32* m_cqTail    = nullptr;
+    uint32* m_cqMask    = nullptr;
+    void*   m_cqes      = nullptr;
+
+    // Requests between io_uring steps, indexed by user_data; a request is
+    // opened, read until full or the file ends, then closed.
+    enum class Step_ { Open, Read, Close };
+    struct Slot_
+    {
+        RequestPtr request;
+        Step_      step;
+    };
+    std::vector<Slot_>  m_slots;
+    std::vector<uint32> m_freeSlots;
+    std::vector<uint32> m_unsubmitted; // Waiting for room in the queue.
+    uint32              m_queued = 0;  // Submitted to io_uring, not reaped.
+    uint32              m_toSubmit = 0; // Queued since the last Enter_().
+
+    bool InitIoUring_(uint32 queueDepth);
+    void CleanupIoUring_();
+    void Reap_(bool wait);
+    void Advance_(uint32 slot, int32 result);
+    bool QueueStep_(uint32 slot);
+    void QueueCancel_(uint32 slot);
+    void Enter_(bool wait);
+    void Complete_(uint32 slot, bool succeeded);
+    static void ReadBlocking_(Request& r);
+};
+
+// Succeeds once the read has landed in its buffer; fails if it couldn't.
+class FileReadProcess : public Process
+{
+public:
+    FileReadProcess(AsyncFileReader& reader, std::string file, void* buffer, uint64 capacity, uint64 offset = 0)
+        : m_reader(reader), m_request(std::make_shared<AsyncFileReader::Request>(std::move(file), buffer, capacity, offset)) {}
+
+    const char* Name()  const override { return "FileReadProcess"; }
+    const AsyncFileReader::Request& FileRequest() const { return *m_request; }
+
+protected:
+    void OnInit() override
+    {
+        if (!m_reader.Submit(m_request))
+        {
+            Fail();
+            return;
+        }
+        m_submitted = true;
+        Process::OnInit();
+    }
+
+    // The buffer's owner may free it once this is aborted or destroyed.
+    void OnAbort()   override { Cancel_(); }
+    void OnCleanup() override { Cancel_(); }
+
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        if (!m_request->Done())
+            return;
+
+        if (m_request->Succeeded())
+        {
+            Succeed();
+        }
+        else
+        {
+            LogWarning("Failed to read file: %s.", m_request->File().c_str());
+            Fail();
+        }
+    }
+
+private:
+    AsyncFileReader&            m_reader;
+    AsyncFileReader::RequestPtr m_request;
+    bool                        m_submitted = false;
+
+    void Cancel_()
+    {
+        if (m_submitted && !m_request->Done())
+            m_reader.Cancel(m_request);
+    }
+};
+
+#endif // ASYNC_FILE_HPP
@@ -0,0 +1,220 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef COROUTINE_PROCESS_HPP
+#define COROUTINE_PROCESS_HPP
+
+// Processes written as coroutines instead of OnUpdate() state machines:
+//
+//     ProcessTask OpenDoor(ProcessManager& pm, Door* door)
+//     {
+//         co_await WaitForEvent<EventUse>();
+//         door->PlaySound();
+//         co_await WaitMilliseconds(500.0f);
+//         Process::StrongPtr swing = ProcessManager::Create<SwingDoor>(door);
+//         pm.Attach(swing);
+//         if (!co_await WaitForProcess(swing))
+//             co_return;
+//         co_await NextFrame();
+//         ...
+//     }
+//
+//     pm.Spawn<CoroutineProcess>(OpenDoor(pm, door));
+//
+// Waiting on a duration, event or process puts the process to sleep, so a
+// waiting coroutine costs nothing per frame but its frame's memory. Frames
+// come from a SizeClassPool rather than the heap.
+//
+// The process succeeds when the coroutine returns, unless it called Fail()
+// on ThisProcess() first.
+// @warning Call coroutine functions on the main thread; the frame pool isn't
+//          thread-safe.
+
+#include "global.hpp"
+#include "pool_allocator.hpp"
+#include "process_manager.hpp"
+
+#include <coroutine>
+#include <exception> // terminate
+#include <utility> // exchange/move
+
+class CoroutineProcess;
+
+class ProcessTask
+{
+public:
+    struct promise_type
+    {
+        CoroutineProcess* process = nullptr;
+
+        ProcessTask get_return_object() { return ProcessTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        static ProcessTask get_return_object_on_allocation_failure() { return ProcessTask(); }
+
+        // Started by the process' first OnUpdate().
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend()   noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) noexcept { return FramePool_().Allocate(size); }
+        static void  operator delete(void* p, size_t size) { FramePool_().Free(p, size); }
+    };
+
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    ProcessTask() {}
+    ~ProcessTask() { if (m_handle) m_handle.destroy(); }
+
+    ProcessTask(ProcessTask&& o) : m_handle(std::exchange(o.m_handle, nullptr)) {}
+    ProcessTask& operator=(ProcessTask&& o)
+    {
+        if (this != &o)
+        {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(o.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ProcessTask(const ProcessTask&) = delete;
+    ProcessTask& operator=(const ProcessTask&) = delete;
+
+    // False if the frame couldn't be allocated.
+    bool IsValid() const { return (bool)m_handle; }
+
+private:
+    friend class CoroutineProcess;
+
+    Handle m_handle;
+
+    explicit ProcessTask(Handle h) : m_handle(h) {}
+
+    static SizeClassPool& FramePool_()
+    {
+        static SizeClassPool pool;
+        return pool;
+    }
+};
+
+class CoroutineProcess : public Process
+{
+public:
+    explicit CoroutineProcess(ProcessTask&& task) : m_task(std::move(task)) {}
+
+protected:
+    void OnInit() override
+    {
+        if (!m_task.IsValid())
+        {
+            LogWarning("Failed to allocate memory for a coroutine.");
+            Fail();
+            return;
+        }
+
+        m_task.m_handle.promise().process = this;
+        Process::OnInit();
+    }
+
+    void OnUpdate(DeltaTime dt) override
+    {
+        m_dt = dt;
+        m_task.m_handle.resume();
+        if (m_task.m_handle.done() && !IsDead())
+            Succeed();
+    }
+
+private:
+    friend class ProcessAwaiter;
+
+    ProcessTask m_task;
+    DeltaTime   m_dt = 0.0f;
+};
+
+// Base of the awaiters below; gives them the process they suspend. Those
+// that put it to sleep resume at once if it can't, e.g., if it was failed
+// or aborted while running.
+class ProcessAwaiter
+{
+protected:
+    static CoroutineProcess& ProcessOf(ProcessTask::Handle h) { return *h.promise().process; }
+    static DeltaTime         DtOf(CoroutineProcess& p)       { return p.m_dt; }
+};
+
+// co_await: the CoroutineProcess running the coroutine.
+inline auto ThisProcess()
+{
+    struct Awaiter : ProcessAwaiter
+    {
+        CoroutineProcess* process = nullptr;
+
+        bool await_ready() const { return false; }
+        bool await_suspend(ProcessTask::Handle h) { process = &ProcessOf(h); return false; }
+        CoroutineProcess& await_resume() const { return *process; }
+    };
+    return Awaiter();
+}
+
+// co_await: resumes in the next ProcessManager::Update(); returns its dt.
+inline auto NextFrame()
+{
+    struct Awaiter : ProcessAwaiter
+    {
+        CoroutineProcess* process = nullptr;
+
+        bool await_ready() const { return false; }
+        void await_suspend(ProcessTask::Handle h) { process = &ProcessOf(h); }
+        DeltaTime await_resume() const { return DtOf(*process); }
+    };
+    return Awaiter();
+}
+
+// co_await: sleeps for milliseconds.
+inline auto WaitMilliseconds(DeltaTime milliseconds)
+{
+    struct Awaiter : ProcessAwaiter
+    {
+        DeltaTime milliseconds;
+
+        bool await_ready() const { return milliseconds <= 0.0f; }
+        bool await_suspend(ProcessTask::Handle h) { return ProcessOf(h).SleepFor(milliseconds); }
+        void await_resume() const {}
+    };
+    return Awaiter{{}, milliseconds};
+}
+
+// co_await: sleeps until an event of type EventT is published.
+template<class EventT>
+auto WaitForEvent()
+{
+    struct Awaiter : ProcessAwaiter
+    {
+        bool await_ready() const { return false; }
+        bool await_suspend(ProcessTask::Handle h) { return ProcessOf(h).template SleepUntilEvent<EventT>(); }
+        void await_resume() const {}
+    };
+    return Awaiter();
+}
+
+// co_await: sleeps until p is dead and returns whether it succeeded.
+// @warning p must be in the coroutine's own ProcessManager, or waiting on
+//          one of its prerequisites there.
+inline auto WaitForProcess(Process::StrongPtr p)
+{
+    struct Awaiter : ProcessAwaiter
+    {
+        Process::StrongPtr process;
+
+        bool await_ready() const { return process->IsDead(); }
+        bool await_suspend(ProcessTask::Handle h) { return ProcessOf(h).SleepUntilProcess(process); }
+        bool await_resume() const { return process->State() == Process::State::Succeeded; }
+    };
+
+    return Awaiter{{}, std::move(p)};
+}
+
+#endif // COROUTINE_PROCESS_HPP
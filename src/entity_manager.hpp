@@ -0,0 +1,627 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef ENTITY_MANAGER_HPP
+#define ENTITY_MANAGER_HPP
+
+// An archetype Entity Component System:
+//
+//     struct Position { glm::vec3 v; };
+//     struct Velocity { glm::vec3 v; };
+//
+//     Entity e = em.Create(Position{}, Velocity{{1.0f, 0.0f, 0.0f}});
+//     em.Each<Position, const Velocity>([dt](Position& p, const Velocity& v)
+//     {
+//         p.v += v.v * dt;
+//     });
+//
+// Entities with the same set of components share an archetype, which stores
+// them in fixed-size chunks as structure-of-arrays: one cache-line-aligned
+// array per component, so a query walks contiguous memory. Adding or removing
+// a component moves the entity to the neighbouring archetype; those edges are
+// cached, so it's a lookup plus a copy of the entity's components.
+//
+// Components can be any type of at most cache-line alignment; they're
+// relocated with their move constructor, or memcpy when trivially copyable.
+// Queries can run on several threads at once, but only with each other.
+// @warning Don't create, destroy, add or remove during a query, or from more
+//          than one thread; that moves the rows being iterated.
+
+#include "global.hpp"
+#include "pool_allocator.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <cstring> // memcpy
+#include <exception> // terminate
+#include <memory> // unique_ptr
+#include <mutex>
+#include <new> // placement new
+#include <type_traits> // decay/remove_cv
+#include <typeinfo> // typeid
+#include <unordered_map>
+#include <utility> // forward/move
+#include <vector>
+
+struct Entity
+{
+    uint32 index      = 0;
+    uint32 generation = 0; // Never 0 while alive, so Entity() is null.
+
+    bool IsNull() const { return generation == 0; }
+    bool operator==(const Entity&) const = default;
+};
+
+// Bit n is set if the archetype has the component with ID n.
+typedef uint64 ComponentMask;
+
+// IDs are handed out on first use, so they're only stable within a run.
+class ComponentTypes
+{
+public:
+    static const uint32 MAX = 64; // Bits in a ComponentMask.
+
+    struct Info
+    {
+        const char* name;
+        uint32      size;
+        bool        trivial; // Relocated by memcpy and never destroyed.
+        void (*relocate)(void* to, void* from); // Move, then destroy from.
+        void (*destroy)(void* p);
+    };
+
+    template<class T>
+    static uint32 Id() { return Id_<std::remove_cv_t<T>>(); }
+
+    template<class T>
+    static ComponentMask Mask() { return (ComponentMask)1 << Id<T>(); }
+
+    static const Info& Get(uint32 id) { return Infos_()[id]; }
+    static uint32 Count() { return Count_().load(std::memory_order_acquire); }
+
+private:
+    template<class T>
+    static uint32 Id_()
+    {
+        static const uint32 id = Register_<T>();
+        return id;
+    }
+
+    template<class T>
+    static uint32 Register_()
+    {
+        static_assert(alignof(T) <= 64, "Components can't be aligned beyond a cache line.");
+
+        uint32 id = Count_().fetch_add(1, std::memory_order_acq_rel);
+        if (id >= MAX)
+        {
+            LogFatal("Too many component types; a ComponentMask holds %u.", MAX);
+            std::terminate();
+        }
+
+        Info& i    = Infos_()[id];
+        i.name     = typeid(T).name();
+        i.size     = sizeof(T);
+        i.trivial  = std::is_trivially_copyable_v<T>;
+        i.relocate = [](void* to, void* from)
+        {
+            new (to) T(std::move(*static_cast<T*>(from)));
+            static_cast<T*>(from)->~T();
+        };
+        i.destroy  = [](void* p) { static_cast<T*>(p)->~T(); };
+        return id;
+    }
+
+    static Info* Infos_()
+    {
+        static Info infos[MAX];
+        return infos;
+    }
+
+    static std::atomic<uint32>& Count_()
+    {
+        static std::atomic<uint32> count{0};
+        return count;
+    }
+};
+
+class EntityManager
+{
+public:
+    static const uint32 CHUNK_SIZE = 16 * 1024;
+
+    EntityManager() : m_chunkPool(CHUNK_SIZE, CACHE_LINE_, 16)
+    {
+        m_empty = FindArchetype_(0);
+    }
+
+    ~EntityManager()
+    {
+        for (auto& a : m_archetypes)
+            DestroyRows_(*a);
+    }
+
+    EntityManager(const EntityManager&) = delete;
+    EntityManager& operator=(const EntityManager&) = delete;
+
+    // Returns a null Entity on failure.
+    Entity Create()
+    {
+        return Create_(*m_empty);
+    }
+
+    // Creates the entity straight into its archetype, without a move per
+    // component. Returns a null Entity on failure.
+    template<class... Ts>
+    Entity Create(Ts&&... components)
+    {
+        Archetype_* a = FindArchetype_((ComponentTypes::Mask<std::decay_t<Ts>>() | ... | (ComponentMask)0));
+        if (!a)
+            return Entity();
+
+        Entity e = Create_(*a);
+        if (!e.IsNull())
+        {
+            const Record_& r = m_records[e.index];
+            (new (Column_(*a, a->column[ComponentTypes::Id<std::decay_t<Ts>>()], r.row)) std::decay_t<Ts>(std::forward<Ts>(components)), ...);
+        }
+        return e;
+    }
+
+    // Returns false if e was already destroyed.
+    bool Destroy(Entity e)
+    {
+        if (!IsAlive(e))
+            return false;
+
+        Record_&    r = m_records[e.index];
+        Archetype_& a = *r.archetype;
+        for (uint32 c = 0; c < a.types.size(); c++)
+        {
+            if (!a.infos[c]->trivial)
+                a.infos[c]->destroy(Column_(a, c, r.row));
+        }
+        RemoveRow_(a, r.row);
+
+        r.archetype = nullptr;
+        if (++r.generation == 0)
+            r.generation = 1;
+        m_freeIndices.push_back(e.index);
+        m_count--;
+        return true;
+    }
+
+    bool IsAlive(Entity e) const
+    {
+        return (e.index < m_records.size() &&
+                m_records[e.index].generation == e.generation &&
+                m_records[e.index].archetype);
+    }
+
+    // Constructs T from args, or assigns it if e already has one. Returns
+    // nullptr if e is dead or memory ran out.
+    // @warning The pointer is invalidated by any change to an archetype.
+    template<class T, class... Args>
+    T* Add(Entity e, Args&&... args)
+    {
+        if (!IsAlive(e))
+            return nullptr;
+
+        uint32 id = ComponentTypes::Id<T>();
+        if (T* existing = Get<T>(e))
+        {
+            *existing = T(std::forward<Args>(args)...);
+            return existing;
+        }
+
+        Archetype_* from = m_records[e.index].archetype;
+        Archetype_* to   = from->add[id];
+        if (!to)
+        {
+            to = FindArchetype_(from->mask | ComponentTypes::Mask<T>());
+            if (!to)
+                return nullptr;
+            from->add[id] = to;
+            to->remove[id] = from;
+        }
+
+        if (!Move_(e, *to))
+            return nullptr;
+        return new (Column_(*to, to->column[id], m_records[e.index].row)) T(std::forward<Args>(args)...);
+    }
+
+    // Returns false if e is dead or memory ran out; true if it didn't have one.
+    template<class T>
+    bool Remove(Entity e)
+    {
+        if (!IsAlive(e))
+            return false;
+
+        uint32 id = ComponentTypes::Id<T>();
+        Archetype_* from = m_records[e.index].archetype;
+        if (from->column[id] < 0)
+            return true;
+
+        Archetype_* to = from->remove[id];
+        if (!to)
+        {
+            to = FindArchetype_(from->mask & ~ComponentTypes::Mask<T>());
+            if (!to)
+                return false;
+            from->remove[id] = to;
+            to->add[id] = from;
+        }
+        return Move_(e, *to);
+    }
+
+    // Returns nullptr if e is dead or doesn't have a T.
+    // @warning The pointer is invalidated by any change to an archetype.
+    template<class T>
+    T* Get(Entity e)
+    {
+        if (!IsAlive(e))
+            return nullptr;
+
+        const Record_& r = m_records[e.index];
+        int8 c = r.archetype->column[ComponentTypes::Id<T>()];
+        return (c < 0 ? nullptr : reinterpret_cast<T*>(Column_(*r.archetype, c, r.row)));
+    }
+
+    template<class T>
+    bool Has(Entity e) const
+    {
+        return (IsAlive(e) && m_records[e.index].archetype->column[ComponentTypes::Id<T>()] >= 0);
+    }
+
+    // Calls f(count, entities, Ts*...) for each chunk of entities with all
+    // of Ts: count rows of contiguous arrays, one per component.
+    template<class... Ts, class F>
+    void EachChunk(F&& f)
+    {
+        for (Archetype_* a : Matching_((ComponentTypes::Mask<Ts>() | ... | (ComponentMask)0)))
+        {
+            for (uint32 i = 0; i < ChunksUsed_(*a); i++)
+                CallChunk_<Ts...>(*a, i, f);
+        }
+    }
+
+    // Calls f(Ts&...) for each entity with all of Ts; const Ts document
+    // which components are only read.
+    template<class... Ts, class F>
+    void Each(F&& f)
+    {
+        EachChunk<Ts...>(EachRow_<Ts...>(f));
+    }
+
+    // EachChunk(), with the chunks split into a few tasks per thread on pool;
+    // f is called concurrently. Returns once every chunk is done, helping
+    // with them meanwhile.
+    template<class... Ts, class F>
+    void ParallelEachChunk(ThreadPool& pool, F&& f)
+    {
+        const std::vector<Archetype_*>& archetypes = Matching_((ComponentTypes::Mask<Ts>() | ... | (ComponentMask)0));
+
+        uint32 chunks = 0;
+        for (Archetype_* a : archetypes)
+            chunks += ChunksUsed_(*a);
+        uint32 perTask = chunks / ((pool.NumThreads() + 1) * TASKS_PER_THREAD_);
+        if (perTask == 0)
+            perTask = 1;
+
+        ThreadPool::TaskGroup tasks;
+        for (Archetype_* a : archetypes)
+        {
+            uint32 used = ChunksUsed_(*a);
+            for (uint32 first = 0; first < used; first += perTask)
+            {
+                uint32 last = (first + perTask < used ? first + perTask : used);
+                pool.Submit(tasks, [a, first, last, &f]
+                {
+                    for (uint32 i = first; i < last; i++)
+                        CallChunk_<Ts...>(*a, i, f);
+                });
+            }
+        }
+        pool.Wait(tasks);
+    }
+
+    // Each(), on pool like ParallelEachChunk().
+    template<class... Ts, class F>
+    void ParallelEach(ThreadPool& pool, F&& f)
+    {
+        ParallelEachChunk<Ts...>(pool, EachRow_<Ts...>(f));
+    }
+
+    // Entities with all of Ts.
+    template<class... Ts>
+    uint32 Count()
+    {
+        uint32 n = 0;
+        for (Archetype_* a : Matching_((ComponentTypes::Mask<Ts>() | ... | (ComponentMask)0)))
+            n += a->count;
+        return n;
+    }
+
+    uint32 Count()          const { return m_count; }
+    uint32 ArchetypeCount() const { return (uint32)m_archetypes.size(); }
+
+private:
+    static const uint32 CACHE_LINE_       = 64;
+    static const uint32 TASKS_PER_THREAD_ = 4; // Evens out uneven chunks.
+
+    struct Archetype_
+    {
+        ComponentMask mask = 0;
+
+        // Per column, in ascending component ID.
+        std::vector<uint32>                       types;
+        std::vector<const ComponentTypes::Info*>  infos;
+        std::vector<uint32>                       offsets; // In a chunk.
+        std::vector<uint32>                       sizes;
+        int8 column[ComponentTypes::MAX]; // -1 if it doesn't have the ID.
+
+        // Rows are packed: every chunk is full but the last, and there's at
+        // most one empty chunk spare. A chunk starts with its Entity array.
+        std::vector<uint8*> chunks;
+        uint32              capacity = 0; // Rows per chunk.
+        uint32              count    = 0;
+
+        // Archetypes one component away, by its ID; filled in as used.
+        Archetype_* add[ComponentTypes::MAX]    = {};
+        Archetype_* remove[ComponentTypes::MAX] = {};
+    };
+
+    struct Record_
+    {
+        Archetype_* archetype  = nullptr; // nullptr if not alive.
+        uint32      row        = 0;
+        uint32      generation = 1;
+    };
+
+    struct Query_
+    {
+        std::vector<Archetype_*> archetypes;
+        uint32                   checked = 0; // Of m_archetypes.
+    };
+
+    FixedPool m_chunkPool;
+    std::vector<std::unique_ptr<Archetype_>>          m_archetypes;
+    std::unordered_map<ComponentMask, Archetype_*>    m_archetypesByMask;
+    std::unordered_map<ComponentMask, Query_>         m_queries;
+    std::mutex                                        m_queriesMutex;
+    Archetype_*                                       m_empty = nullptr;
+
+    std::vector<Record_> m_records;
+    std::vector<uint32>  m_freeIndices;
+    uint32               m_count = 0;
+
+    static uint32 AlignUp_(uint32 n) { return (n + CACHE_LINE_ - 1) & ~(CACHE_LINE_ - 1); }
+
+    static uint8* Column_(Archetype_& a, uint32 c, uint32 row)
+    {
+        return a.chunks[row / a.capacity] + a.offsets[c] + (row % a.capacity) * a.sizes[c];
+    }
+
+    static Entity& EntityAt_(Archetype_& a, uint32 row)
+    {
+        return reinterpret_cast<Entity*>(a.chunks[row / a.capacity])[row % a.capacity];
+    }
+
+    // Returns nullptr if a row of mask's components doesn't fit in a chunk.
+    Archetype_* FindArchetype_(ComponentMask mask)
+    {
+        auto it = m_archetypesByMask.find(mask);
+        if (it != m_archetypesByMask.end())
+            return it->second;
+
+        std::unique_ptr<Archetype_> a(new (std::nothrow) Archetype_);
+        if (!a)
+            return nullptr;
+
+        a->mask = mask;
+        for (int8& c : a->column)
+            c = -1;
+        uint32 rowSize = sizeof(Entity);
+        for (uint32 id = 0; id < ComponentTypes::MAX; id++)
+        {
+            if (!(mask & ((ComponentMask)1 << id)))
+                continue;
+
+            const ComponentTypes::Info& info = ComponentTypes::Get(id);
+            a->column[id] = (int8)a->types.size();
+            a->types.push_back(id);
+            a->infos.push_back(&info);
+            a->sizes.push_back(info.size);
+            rowSize += info.size;
+        }
+        a->offsets.resize(a->types.size());
+
+        // Each array starts on a cache line, so shrink until the padding fits.
+        for (uint32 capacity = CHUNK_SIZE / rowSize; capacity > 0; capacity--)
+        {
+            uint32 end = capacity * (uint32)sizeof(Entity);
+            for (uint32 c = 0; c < a->types.size(); c++)
+            {
+                a->offsets[c] = AlignUp_(end);
+                end = a->offsets[c] + capacity * a->sizes[c];
+            }
+            if (end <= CHUNK_SIZE)
+            {
+                a->capacity = capacity;
+                break;
+            }
+        }
+        if (a->capacity == 0)
+        {
+            LogWarning("An entity's components don't fit in a %u byte chunk.", CHUNK_SIZE);
+            return nullptr;
+        }
+
+        Archetype_* p = a.get();
+        m_archetypes.push_back(std::move(a));
+        m_archetypesByMask[mask] = p;
+        return p;
+    }
+
+    // Archetypes only change between queries, so the vector can be read
+    // unlocked once it's caught up.
+    const std::vector<Archetype_*>& Matching_(ComponentMask mask)
+    {
+        std::lock_guard<std::mutex> lock(m_queriesMutex);
+        Query_& q = m_queries[mask];
+        for (; q.checked < m_archetypes.size(); q.checked++)
+        {
+            Archetype_* a = m_archetypes[q.checked].get();
+            if ((a->mask & mask) == mask)
+                q.archetypes.push_back(a);
+        }
+        return q.archetypes;
+    }
+
+    static uint32 ChunksUsed_(const Archetype_& a) { return (a.count + a.capacity - 1) / a.capacity; }
+
+    template<class... Ts, class F>
+    static void CallChunk_(Archetype_& a, uint32 i, F& f)
+    {
+        uint32 n     = (i + 1 < ChunksUsed_(a) ? a.capacity : a.count - i * a.capacity);
+        uint8* chunk = a.chunks[i];
+        f(n, reinterpret_cast<const Entity*>(chunk),
+          reinterpret_cast<Ts*>(chunk + a.offsets[a.column[ComponentTypes::Id<Ts>()]])...);
+    }
+
+    template<class... Ts, class F>
+    static auto EachRow_(F& f)
+    {
+        return [&f](uint32 n, const Entity* /*entities*/, Ts*... columns)
+        {
+            for (uint32 i = 0; i < n; i++)
+                f(columns[i]...);
+        };
+    }
+
+    Entity Create_(Archetype_& a)
+    {
+        uint32 row;
+        if (!AllocateRow_(a, row))
+            return Entity();
+
+        uint32 index;
+        if (m_freeIndices.empty())
+        {
+            index = (uint32)m_records.size();
+            m_records.emplace_back();
+        }
+        else
+        {
+            index = m_freeIndices.back();
+            m_freeIndices.pop_back();
+        }
+
+        Record_& r  = m_records[index];
+        r.archetype = &a;
+        r.row       = row;
+        Entity e{index, r.generation};
+        EntityAt_(a, row) = e;
+        m_count++;
+        return e;
+    }
+
+    bool AllocateRow_(Archetype_& a, uint32& row)
+    {
+        if (a.count / a.capacity >= a.chunks.size())
+        {
+            void* chunk = m_chunkPool.Allocate();
+            if (!chunk)
+            {
+                LogWarning("Failed to allocate memory for entities.");
+                return false;
+            }
+            a.chunks.push_back(static_cast<uint8*>(chunk));
+        }
+        row = a.count++;
+        return true;
+    }
+
+    // Fills row, whose components are already moved out or destroyed, with
+    // the last row.
+    void RemoveRow_(Archetype_& a, uint32 row)
+    {
+        uint32 last = --a.count;
+        if (row != last)
+        {
+            for (uint32 c = 0; c < a.types.size(); c++)
+            {
+                void* to   = Column_(a, c, row);
+                void* from = Column_(a, c, last);
+                if (a.infos[c]->trivial)
+                    std::memcpy(to, from, a.sizes[c]);
+                else
+                    a.infos[c]->relocate(to, from);
+            }
+            Entity moved = EntityAt_(a, last);
+            EntityAt_(a, row) = moved;
+            m_records[moved.index].row = row;
+        }
+
+        uint32 used = ChunksUsed_(a);
+        while (a.chunks.size() > used + 1)
+        {
+            m_chunkPool.Free(a.chunks.back());
+            a.chunks.pop_back();
+        }
+    }
+
+    // Moves e's shared components to a new row in to, destroys the rest, and
+    // leaves to's other components unconstructed.
+    bool Move_(Entity e, Archetype_& to)
+    {
+        Record_&    r    = m_records[e.index];
+        Archetype_& from = *r.archetype;
+
+        uint32 row;
+        if (!AllocateRow_(to, row))
+            return false;
+        EntityAt_(to, row) = e;
+
+        for (uint32 c = 0; c < from.types.size(); c++)
+        {
+            void*  p = Column_(from, c, r.row);
+            int8 toC = to.column[from.types[c]];
+            if (toC < 0)
+            {
+                if (!from.infos[c]->trivial)
+                    from.infos[c]->destroy(p);
+            }
+            else if (from.infos[c]->trivial)
+            {
+                std::memcpy(Column_(to, toC, row), p, from.sizes[c]);
+            }
+            else
+            {
+                from.infos[c]->relocate(Column_(to, toC, row), p);
+            }
+        }
+
+        RemoveRow_(from, r.row);
+        r.archetype = &to;
+        r.row       = row;
+        return true;
+    }
+
+    void DestroyRows_(Archetype_& a)
+    {
+        for (uint32 c = 0; c < a.types.size(); c++)
+        {
+            if (a.infos[c]->trivial)
+                continue;
+            for (uint32 row = 0; row < a.count; row++)
+                a.infos[c]->destroy(Column_(a, c, row));
+        }
+    }
+};
+
+#endif // ENTITY_MANAGER_HPP
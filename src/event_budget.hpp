@@ -0,0 +1,89 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef EVENT_BUDGET_HPP
+#define EVENT_BUDGET_HPP
+
+#include "global.hpp"
+
+// What EventBus::Update() does with events it couldn't get to when the
+// backlog is over its limit.
+enum class EventShedPolicy
+{
+    Keep,       // Defer everything; the backlog can grow without bound.
+    DropOldest, // Drop the oldest deferred events.
+    DropNewest  // Drop the newest deferred events.
+};
+
+// What an EventBus queue does with an event that doesn't fit; see
+// EventBus::SetQueueLimits().
+enum class EventOverflowPolicy
+{
+    DropOldest,
+    DropNewest,
+    // Merge it into the newest queued event of its type, using the type's
+    // coalescer if it has one or replacing that event if not; DropOldest
+    // when none is queued.
+    Coalesce,
+    // Don't drop: PublishThreadSafe() on other threads waits for room, and
+    // the main thread, which can't wait on itself, grows the queue instead,
+    // up to EventBus::BLOCK_GROWTH_LIMIT times its capacity; past that, the
+    // main thread's events are dropped like DropNewest.
+    Block
+};
+
+// Sizes the time EventBus::Update() may spend each frame so the whole frame
+// stays near a target frame rate. Additive increase while there's a backlog
+// and frames are on time, multiplicative decrease when frames run long.
+class EventBudget
+{
+public:
+    EventBudget(float32 targetFrameRate, DeltaTime minMilliseconds, float32 maxFrameFraction)
+    {
+        m_targetMilliseconds = 1000.0f / targetFrameRate;
+        m_minMilliseconds    = minMilliseconds;
+        m_maxMilliseconds    = m_targetMilliseconds * maxFrameFraction;
+        if (m_maxMilliseconds < m_minMilliseconds)
+            m_maxMilliseconds = m_minMilliseconds;
+        m_budget             = m_maxMilliseconds;
+        m_frameAverage       = m_targetMilliseconds;
+    }
+
+    // Call once per frame with the previous frame's time and the number of
+    // events EventBus::Update() had to defer.
+    void Update(DeltaTime frameMilliseconds, uint32 backlogDepth)
+    {
+        m_frameAverage += (frameMilliseconds - m_frameAverage) * FRAME_AVERAGE_WEIGHT;
+
+        if (m_frameAverage > m_targetMilliseconds * (1.0f + FRAME_TOLERANCE))
+            m_budget *= DECREASE_FACTOR;
+        else if (backlogDepth > 0)
+            m_budget += INCREASE_MILLISECONDS;
+
+        if (m_budget < m_minMilliseconds)
+            m_budget = m_minMilliseconds;
+        else if (m_budget > m_maxMilliseconds)
+            m_budget = m_maxMilliseconds;
+    }
+
+    DeltaTime Milliseconds()             const { return m_budget; }
+    DeltaTime AverageFrameMilliseconds() const { return m_frameAverage; }
+
+private:
+    static constexpr float32   FRAME_AVERAGE_WEIGHT  = 0.1f;
+    static constexpr float32   FRAME_TOLERANCE       = 0.05f; // Absorbs vsync jitter.
+    static constexpr float32   DECREASE_FACTOR       = 0.75f;
+    static constexpr DeltaTime INCREASE_MILLISECONDS = 0.25f;
+
+    DeltaTime m_targetMilliseconds;
+    DeltaTime m_minMilliseconds;
+    DeltaTime m_maxMilliseconds;
+    DeltaTime m_budget;
+    DeltaTime m_frameAverage;
+};
+
+#endif // EVENT_BUDGET_HPP
@@ -15,172 +15,1653 @@
 
 #include "global.hpp"
 #include "app.hpp"
+#include "event_budget.hpp"
+#include "event_metrics.hpp"
+#include "frame_arena.hpp"
+#include "event_recorder.hpp"
+#include "event_tap.hpp"
+#include "mpsc_queue.hpp"
+#include "ring_buffer.hpp"
+#include "thread_pool.hpp"
+#include "timer_wheel.hpp"
 
+#include <cstdio>
+#include <atomic>
+#include <cstring> // memcpy
 #include <functional> // bind/function/placeholders
-#include <list>
-#include <map>
 #include <memory> // make_shared/shared_ptr/weak_ptr
+#include <mutex>
+#include <string>
+#include <thread> // this_thread
+#include <type_traits> // decay/is_trivially_copyable
+#include <unordered_map>
+#include <utility> // forward/move
+#include <vector>
 
 //-- These are passed to EventBus::Subscribe(HERE):
+//   @note Prefer the typed EventBus::Subscribe<EventT, ...>() overloads; they
+//         skip std::bind/std::function and the handler's dynamic_cast.
 #define EVENTBUS_SUB_FUNCTION(f, t)           std::bind(f, std::placeholders::_1),     t::TYPE
 #define EVENTBUS_SUB_INSTANCE_MEMBER(f, i, t) std::bind(&f, i, std::placeholders::_1), t::TYPE
 #define EVENTBUS_SUB_THIS_MEMBER(f, t)        EVENTBUS_SUB_INSTANCE_MEMBER(f, this, t)
 //--
 
 //-- Define a new event type:
-#define EVENT_BEGIN(name, type)                    \
-    class name : public IEvent                     \
-    {                                              \
-    public:                                        \
-        static const UUID TYPE = type;             \
-        UUID   Type() const { return type; }       \
-        const char* Name() const { return #name; }
-#define EVENT_END };
+//       EVENT_BEGIN(EventHit)
+//           UUID    target;
+//           float32 damage;
+//       EVENT_END(EventHit)
+//       bus.Publish<EventHit>(target, damage);
+//   The type's UUID is a hash of its name, so names must be unique; see
+//   EventTypes::CollisionCount().
+//   Members go in EventHitData, which EventHit derives from; EventHit is
+//   constructed from every member in order, or from none, which zeroes them.
+//   @note Events are recorded and replayed bytewise (see
+//         EventBus::StartRecording()), so their members must be trivially
+//         copyable, which is checked; no pointers or std::strings.
+#define EVENT_BEGIN_PRIORITY(name, priority)                                 \
+    struct name##Data : EventData<name##Data>                                \
+    {                                                                        \
+        static constexpr EventPriority PRIORITY = priority;
+#define EVENT_BEGIN(name) EVENT_BEGIN_PRIORITY(name, EventPriority::Normal)
+#define EVENT_END(name)                                                      \
+    };                                                                       \
+    class name : public IEvent, public name##Data                            \
+    {                                                                        \
+    public:                                                                  \
+        static_assert(std::is_trivially_copyable_v<name##Data> &&            \
+                      std::is_standard_layout_v<name##Data>,                 \
+                      #name "'s members must be trivially copyable.");       \
+        static constexpr UUID TYPE = EventTypeId(#name);                     \
+        static constexpr const char* NAME = #name;                           \
+        static EventTypeIndex INDEX()                                        \
+        {                                                                    \
+            static const EventTypeIndex i =                                  \
+                EventTypes::Register(TYPE, NAME, &name::Replay);             \
+            return i;                                                        \
+        }                                                                    \
+        name() : name##Data() {}                                             \
+        template<class... Args>                                              \
+            requires requires(Args&&... args)                                \
+                { name##Data{{}, std::forward<Args>(args)...}; }             \
+        explicit name(Args&&... args)                                        \
+            : name##Data{{}, std::forward<Args>(args)...} {}                 \
+        UUID           Type()     const { return TYPE; }                     \
+        EventTypeIndex Index()    const { return INDEX(); }                  \
+        const char*    Name()     const { return NAME; }                     \
+        EventPriority  Priority() const { return PRIORITY; }                 \
+        IEvent* MoveInto(FrameArena& a)                                      \
+        {                                                                    \
+            return a.New<name>(std::move(*this));                            \
+        }                                                                    \
+        IEvent* CopyInto(FrameArena& a) const                                \
+        {                                                                    \
+            return a.New<name>(*this);                                       \
+        }                                                                    \
+        const void* Payload() const                                          \
+        {                                                                    \
+            return static_cast<const name##Data*>(this);                     \
+        }                                                                    \
+        uint32 PayloadSize() const { return sizeof(name##Data); }            \
+        static IEvent* Replay(FrameArena& a, const void* p, uint32 size)     \
+        {                                                                    \
+            if (size != sizeof(name##Data))                                  \
+                return nullptr;                                              \
+            name* e = a.New<name>();                                         \
+            if (e)                                                           \
+                std::memcpy(static_cast<name##Data*>(e), p, size);           \
+            return e;                                                        \
+        }                                                                    \
+    private:                                                                 \
+        /* Registers every event type before main(), so IDs are checked  */  \
+        /* for collisions up front and indices are assigned in one go.   */  \
+        static inline const EventTypeIndex REGISTERED_ = INDEX();            \
+    };
 //--
 
+// Small, dense, per-process index assigned to each event UUID the first time
+// it's seen, so per-type tables can be plain arrays instead of maps.
+typedef uint32 EventTypeIndex;
+
+// 32-bit FNV-1a of an event's name; stable across builds, so it's what's
+// recorded and what Subscribe(Subscriber, UUID) takes.
+constexpr UUID EventTypeId(const char* name)
+{
+    uint32 h = 2166136261u;
+    while (*name)
+    {
+        h ^= (uint8)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+class IEvent;
+
+// Base of every event's members; see EVENT_BEGIN(). Zeroes them, padding
+// included, before they're initialized, so recordings never hold whatever
+// was in memory before.
+template<class DataT>
+struct EventData
+{
+    EventData() { std::memset((void*)this, 0, sizeof(DataT)); }
+};
+
+// Constructs an event in a from a recorded payload; nullptr on failure.
+typedef IEvent* (*EventReplayFunction)(FrameArena& a, const void* payload, uint32 size);
+
+class EventTypes
+{
+public:
+    // Only called at registration (subscription or first use of an event
+    // type) and while replaying; never on the publish/dispatch path.
+    // Thread-safe.
+    static EventTypeIndex IndexOf(UUID type)
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        return IndexOf_(type);
+    }
+
+    // IndexOf() for event classes, which can also be replayed. Every event
+    // class registers itself before main().
+    static EventTypeIndex Register(UUID type, const char* name, EventReplayFunction replay)
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        EventTypeIndex i = IndexOf_(type);
+
+        Info_& info = Infos_()[i];
+        if (info.name && std::strcmp(info.name, name) != 0)
+        {
+            LogFatal("Event types %s and %s have the same ID %08X.", info.name, name, (unsigned)type);
+            CollisionCount_()++;
+            return i;
+        }
+        info.name   = name;
+        info.replay = replay;
+        return i;
+    }
+
+    // Event classes whose IDs collided with another's; App::Init() fails if
+    // there are any.
+    static uint32 CollisionCount()
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        return CollisionCount_();
+    }
+
+    // Registered event classes and UUIDs subscribed to.
+    static uint32 Count()
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        return Infos_().size();
+    }
+
+    // nullptr for a UUID without an event class.
+    static const char* Name(EventTypeIndex i)
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        return (i < Infos_().size() ? Infos_()[i].name : nullptr);
+    }
+
+    // nullptr if no event class with this UUID has been used yet.
+    static EventReplayFunction ReplayFunction(UUID type)
+    {
+        std::lock_guard<std::mutex> lock(Mutex_());
+        std::unordered_map<UUID, EventTypeIndex>& m = Indices_();
+        auto it = m.find(type);
+        return (it == m.end() ? nullptr : Infos_()[it->second].replay);
+    }
+
+private:
+    static std::mutex& Mutex_()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::unordered_map<UUID, EventTypeIndex>& Indices_()
+    {
+        static std::unordered_map<UUID, EventTypeIndex> m;
+        return m;
+    }
+
+    struct Info_
+    {
+        const char*         name   = nullptr;
+        EventReplayFunction replay = nullptr;
+    };
+
+    // Indexed by EventTypeIndex.
+    static std::vector<Info_>& Infos_()
+    {
+        static std::vector<Info_> v;
+        return v;
+    }
+
+    static uint32& CollisionCount_()
+    {
+        static uint32 count = 0;
+        return count;
+    }
+
+    static EventTypeIndex IndexOf_(UUID type)
+    {
+        std::unordered_map<UUID, EventTypeIndex>& m = Indices_();
+        auto it = m.find(type);
+        if (it != m.end())
+            return it->second;
+
+        EventTypeIndex i = (EventTypeIndex)m.size();
+        m[type] = i;
+        Infos_().push_back(Info_());
+        return i;
+    }
+};
+
+// EventBus::Update() drains each class in order; only Critical events are
+// guaranteed to be dispatched the frame after they're published.
+enum class EventPriority : uint32
+{
+    Critical,   // Never deferred or shed, e.g., quit or resize.
+    Normal,
+    Deferrable, // Cosmetic; deferred and shed first.
+    Count
+};
+
+// Where a subscriber may be called.
+// @warning Concurrent subscribers must be thread-safe: they can run on any
+//          worker, concurrently with each other, with the main thread, and
+//          with themselves for other events. They mustn't touch the EventBus
+//          other than PublishThreadSafe().
+enum class EventDispatch
+{
+    MainThread,
+    // When every subscriber to an event is Concurrent, EventBus::Update()
+    // dispatches it on its thread pool, out of order with main thread
+    // events, and waits for it before returning.
+    Concurrent
+};
+
 class IEvent
 {
 public:
     virtual ~IEvent() {}
 
-    virtual UUID        Type() const = 0;
-    virtual const char* Name() const = 0;
+    virtual UUID           Type()     const = 0;
+    virtual EventTypeIndex Index()    const = 0;
+    virtual const char*    Name()     const = 0;
+    virtual EventPriority  Priority() const = 0;
+
+    // Move-constructs a copy of this event in a; returns nullptr on failure.
+    virtual IEvent* MoveInto(FrameArena& a) = 0;
+    // Copy-constructs one instead.
+    virtual IEvent* CopyInto(FrameArena& a) const = 0;
+
+    // The derived event's members, as recorded by EventBus.
+    virtual const void* Payload()     const = 0;
+    virtual uint32      PayloadSize() const = 0;
 };
 
 typedef std::shared_ptr<IEvent> EventStrongPtr;
 typedef std::weak_ptr<IEvent>   EventWeakPtr;
 
-// @note SubscriberIDStrongPtr/WeakPtr are used to catch dead subscribers at
-//       attempted usage and unsubscribe them rather than trying to use
-//       invalid memory.
 class EventBus
 {
 public:
-    typedef uint32 SubscriberID;
-    typedef std::shared_ptr<SubscriberID> SubscriberIDStrongPtr;
-    typedef std::weak_ptr<SubscriberID> SubscriberIDWeakPtr;
+    // Index into the subscriber slot map; generation is bumped whenever the
+    // slot is freed, so stale handles are detected instead of reused.
+    struct SubscriberHandle
+    {
+        uint32 index      = 0;
+        uint32 generation = 0;
+    };
+
+    // Unsubscribes when destroyed or Reset().
+    // @warning The EventBus must outlive its Subscriptions.
+    class Subscription
+    {
+    public:
+        Subscription() {}
+        ~Subscription() { Reset(); }
+
+        Subscription(Subscription&& o) : m_bus(o.m_bus), m_handle(o.m_handle) { o.m_bus = nullptr; }
+        Subscription& operator=(Subscription&& o)
+        {
+            if (this != &o)
+            {
+                Reset();
+                m_bus    = o.m_bus;
+                m_handle = o.m_handle;
+                o.m_bus  = nullptr;
+            }
+            return *this;
+        }
+
+        Subscription(const Subscription&) = delete;
+        Subscription& operator=(const Subscription&) = delete;
+
+        bool IsSubscribed() const { return m_bus != nullptr; }
+
+        void Reset()
+        {
+            if (m_bus)
+            {
+                m_bus->Unsubscribe_(m_handle);
+                m_bus = nullptr;
+            }
+        }
 
-    typedef void SubscriberSignature(EventStrongPtr e);
+    private:
+        friend class EventBus;
+
+        EventBus*        m_bus = nullptr;
+        SubscriberHandle m_handle;
+
+        Subscription(EventBus* bus, SubscriberHandle handle) : m_bus(bus), m_handle(handle) {}
+    };
+
+    // Returned by PublishAt()/PublishAfter(); see CancelScheduled().
+    typedef TimerWheel<EventStrongPtr>::Handle ScheduledEvent;
+
+    static const uint32 DEFAULT_QUEUE_CAPACITY = 4096;
+    // Times its capacity a Block queue, or the thread-safe queue, can fill to.
+    static const uint32 BLOCK_GROWTH_LIMIT     = 2;
+
+    EventBus() : m_timerTickLength(TimerTickLength_()), m_timers(TimerTick_(App::Time()))
+    {
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+        {
+            SetQueueLimits((EventPriority)p, DEFAULT_QUEUE_CAPACITY,
+                           (p == (uint32)EventPriority::Critical ? EventOverflowPolicy::Block : EventOverflowPolicy::DropOldest));
+        }
+    }
+
+    typedef void SubscriberSignature(IEvent& e);
     typedef std::function<SubscriberSignature> Subscriber;
 
-    SubscriberIDStrongPtr Subscribe(const Subscriber& subscriber, UUID type)
+    // Merges incoming into queued, which is the same type.
+    typedef void CoalescerSignature(IEvent& queued, const IEvent& incoming);
+    typedef std::function<CoalescerSignature> Coalescer;
+
+    Subscription Subscribe(const Subscriber& subscriber, UUID type, EventDispatch dispatch = EventDispatch::MainThread)
     {
-        SubscriberIDStrongPtr sid = std::make_shared<SubscriberID>(NewSubscriberID());
-        SubscriberWithIDWeakPtr_ s;
-        s.s = subscriber;
-        s.id = sid;
-        m_subscribers[type].push_back(s);
-        return sid;
+        std::shared_ptr<Subscriber> s = std::make_shared<Subscriber>(subscriber);
+        return Subscribe_(EventTypes::IndexOf(type), &CallSubscriber_, s.get(), s, dispatch);
     }
 
-    void PublishNow(const EventStrongPtr& event)
+    // Calls (instance->*Handler)(const EventT&), e.g.:
+    //     Subscribe<EventMoveCamera, &Logic::OnMoveCamera>(this);
+    template<class EventT, auto Handler, class T>
+    Subscription Subscribe(T* instance, EventDispatch dispatch = EventDispatch::MainThread)
     {
-        auto findIt = m_subscribers.find(event->Type());
-        if (findIt == m_subscribers.end())
+        return Subscribe_(EventT::INDEX(), &CallMember_<EventT, T, Handler>, instance, nullptr, dispatch);
+    }
+
+    // Calls Handler(const EventT&).
+    template<class EventT, void (*Handler)(const EventT&)>
+    Subscription Subscribe(EventDispatch dispatch = EventDispatch::MainThread)
+    {
+        return Subscribe_(EventT::INDEX(), &CallFunction_<EventT, Handler>, nullptr, nullptr, dispatch);
+    }
+
+    // Calls a copy of f(const EventT&), e.g., a lambda.
+    template<class EventT, class F>
+    Subscription Subscribe(F&& f, EventDispatch dispatch = EventDispatch::MainThread)
+    {
+        typedef typename std::decay<F>::type Callable;
+        std::shared_ptr<Callable> c = std::make_shared<Callable>(std::forward<F>(f));
+        return Subscribe_(EventT::INDEX(), &CallCallable_<EventT, Callable>, c.get(), c, dispatch);
+    }
+
+    // Without a pool, Concurrent subscribers are called on the main thread.
+    // @warning The pool must outlive the EventBus, or be unset first.
+    void SetThreadPool(ThreadPool* pool) { m_threadPool = pool; }
+
+    void PublishNow(IEvent& event)
+    {
+        EventTypeIndex i = event.Index();
+        if (!HasSubscribers_(i))
+            return;
+
+        if (m_metricsEnabled)
+            m_metrics[i].published++;
+        Dispatch_(i, event);
+    }
+
+    // Constructs the event on the stack and dispatches it immediately.
+    template<class EventT, class... Args>
+    void PublishNow(Args&&... args)
+    {
+        if (!HasSubscribers_(EventT::INDEX()))
             return;
 
-        SubscriberList& l = findIt->second;
-        auto it = l.begin();
-        while (it != l.end())
+        if (m_metricsEnabled)
+            m_metrics[EventT::INDEX()].published++;
+
+        EventT e(std::forward<Args>(args)...);
+        Dispatch_(EventT::INDEX(), e);
+    }
+
+    // Queues an event that's shared with the caller; use this for the rare
+    // events that need to outlive the frame they're dispatched in.
+    // @note Shared events are merged into a queued event when their type has
+    //       a coalescer, but they're never merged into themselves.
+    void Publish(const EventStrongPtr& event)
+    {
+        EventTypeIndex i = event->Index();
+        if (!HasSubscribers_(i) || Suppressed_())
+            return;
+
+        Record_(*event);
+        if (m_metricsEnabled)
+            m_metrics[i].published++;
+
+        IEvent* target = CoalesceTarget_(i);
+        if (target)
         {
-            auto thisIt = it++;
-            SubscriberWithIDWeakPtr_& s = *thisIt;
-            SubscriberIDStrongPtr sid = s.id.lock();
-            if (sid)
-                s.s(event);
-            else
-                l.erase(thisIt);
+            m_coalescing[i].coalescer(*target, *event);
+            if (m_metricsEnabled)
+                m_metrics[i].coalesced++;
+        }
+        else
+        {
+            Enqueue_(QueuedEvent_{event.get(), event, PublishTime_()});
         }
     }
 
-    void Publish(const EventStrongPtr& event)
+    // Constructs the event in this frame's arena and queues it; the event is
+    // destroyed after the Update() that dispatches it.
+    template<class EventT, class... Args>
+    void Publish(Args&&... args)
+    {
+        EventTypeIndex i = EventT::INDEX();
+        if (!HasSubscribers_(i) || Suppressed_())
+            return;
+
+        if (m_metricsEnabled)
+            m_metrics[i].published++;
+
+        IEvent* target = CoalesceTarget_(i);
+        if (target)
+        {
+            EventT incoming(std::forward<Args>(args)...);
+            Record_(incoming);
+            m_coalescing[i].coalescer(*target, incoming);
+            if (m_metricsEnabled)
+                m_metrics[i].coalesced++;
+            return;
+        }
+
+        EventT* e = m_arenas[m_activeQueue].New<EventT>(std::forward<Args>(args)...);
+        if (!e)
+        {
+            LogWarning("Failed to allocate memory for event %s; dropped.", EventT::NAME);
+            return;
+        }
+        Record_(*e);
+        QueueArenaEvent_(i, e);
+    }
+
+    // Until the next Update(), events of type EventT are merged into the
+    // first one still queued rather than queued themselves, e.g., summing
+    // mouse deltas so subscribers run once per frame regardless of the input
+    // rate. The merged event keeps the first event's place in the queue.
+    template<class EventT>
+    void SetCoalescer(const std::function<void(EventT& queued, const EventT& incoming)>& c)
+    {
+        EventTypeIndex i = EventT::INDEX();
+        if (i >= m_coalescing.size())
+            m_coalescing.resize(i + 1);
+
+        Coalescing_& co = m_coalescing[i];
+        co.queued = nullptr;
+        if (c)
+        {
+            co.coalescer = [c](IEvent& queued, const IEvent& incoming)
+            {
+                c(static_cast<EventT&>(queued), static_cast<const EventT&>(incoming));
+            };
+        }
+        else
+        {
+            co.coalescer = nullptr;
+        }
+    }
+
+    template<class EventT>
+    static void CoalesceKeepLatest(EventT& queued, const EventT& incoming) { queued = incoming; }
+
+    // Safe to call from any thread; the event is queued at the start of the
+    // next Update(), or of a later one while its priority's queue is full,
+    // so none are dropped: waiting events are only limited by memory.
+    // With a thread-safe capacity (see SetThreadSafeCapacity()), events past
+    // it are handled by their priority's overflow policy: Block waits for
+    // room, except on the EventBus' own thread; DropNewest drops the event;
+    // DropOldest and Coalesce drop the oldest waiting event of its priority
+    // instead. Critical events always Block. The owner thread's Block and
+    // DropOldest and Coalesce, which leave the dropping to Update(), give way
+    // to DropNewest at BLOCK_GROWTH_LIMIT times the capacity, so that's the
+    // most that can be waiting. Dropped events are counted by ShedCount(),
+    // though only those Update() drops by their type's metrics, and
+    // overflows are logged at most once a second.
+    void PublishThreadSafe(const EventStrongPtr& event)
+    {
+        uint32              p      = (uint32)event->Priority();
+        EventOverflowPolicy policy = (p == (uint32)EventPriority::Critical ? EventOverflowPolicy::Block : m_lanes[p].policy);
+        bool overflowed = false;
+        uint32 n = m_threadSafeCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        while (m_threadSafeCapacity > 0 && n > m_threadSafeCapacity)
+        {
+            bool owner   = (std::this_thread::get_id() == m_ownerThread);
+            bool atLimit = (n > m_threadSafeCapacity * BLOCK_GROWTH_LIMIT);
+            if (policy == EventOverflowPolicy::Block && owner && !atLimit)
+                break;
+
+            if (!overflowed)
+                m_threadSafeOverflows.fetch_add(1, std::memory_order_relaxed);
+            overflowed = true;
+
+            if (policy == EventOverflowPolicy::DropNewest || (atLimit && (policy != EventOverflowPolicy::Block || owner)))
+            {
+                m_threadSafeCount.fetch_sub(1, std::memory_order_relaxed);
+                m_threadSafeDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (policy != EventOverflowPolicy::Block)
+            {
+                // Update() drops the oldest of p before it queues any more.
+                m_threadSafeEvictions[p].fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+
+            m_threadSafeCount.fetch_sub(1, std::memory_order_relaxed);
+            std::this_thread::yield(); // Until Update() drains it.
+            n = m_threadSafeCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        uint32 highWater = m_threadSafeHighWater.load(std::memory_order_relaxed);
+        while (n > highWater && !m_threadSafeHighWater.compare_exchange_weak(highWater, n, std::memory_order_relaxed))
+            ;
+
+        // Stamped here so residency includes the wait for Update().
+        if (!m_threadSafeQueue.Push(QueuedEvent_{event.get(), event, App::Time()}))
+        {
+            m_threadSafeCount.fetch_sub(1, std::memory_order_relaxed);
+            LogWarning("Failed to allocate memory for event %s; dropped.", event->Name());
+        }
+    }
+
+    template<class EventT, class... Args>
+    void PublishThreadSafe(Args&&... args)
     {
-        if (m_subscribers.find(event->Type()) != m_subscribers.end())
-            m_queues[m_activeQueue].push_back(event);
+        PublishThreadSafe(std::make_shared<EventT>(std::forward<Args>(args)...));
     }
 
+    // Publishes event in the first Update() at or after time, an App::Time();
+    // accurate to a millisecond. Scheduling and expiry are O(1), so pending
+    // events cost nothing until they're due.
+    ScheduledEvent PublishAt(TimeStamp time, const EventStrongPtr& event)
+    {
+        if (time <= App::Time())
+        {
+            // Already due; it can't be cancelled.
+            Publish(event);
+            return ScheduledEvent();
+        }
+        return m_timers.Schedule(TimerTick_(time) + (time % m_timerTickLength ? 1 : 0), event);
+    }
+
+    template<class EventT, class... Args>
+    ScheduledEvent PublishAt(TimeStamp time, Args&&... args)
+    {
+        return PublishAt(time, std::make_shared<EventT>(std::forward<Args>(args)...));
+    }
+
+    ScheduledEvent PublishAfter(DeltaTime milliseconds, const EventStrongPtr& event)
+    {
+        return PublishAt(App::Time() + (TimeStamp)(milliseconds * (DeltaTime)App::TimePerSecond() / 1000.0f), event);
+    }
+
+    template<class EventT, class... Args>
+    ScheduledEvent PublishAfter(DeltaTime milliseconds, Args&&... args)
+    {
+        return PublishAfter(milliseconds, std::make_shared<EventT>(std::forward<Args>(args)...));
+    }
+
+    // Returns false if the event was already published or cancelled.
+    bool CancelScheduled(ScheduledEvent e) { return m_timers.Cancel(e); }
+
+    uint32 ScheduledCount() const { return m_timers.Count(); }
+
+    // Each priority has a queue of capacity events, rounded up to a power of
+    // two, handling overflow according to policy. Critical defaults to Block
+    // and the rest to DropOldest. A Block queue grows to at most
+    // BLOCK_GROWTH_LIMIT times its capacity, then drops the newest events
+    // with a warning, so a priority never queues more than that many of its
+    // own events and NUM_QUEUES times that in all.
+    // @warning Call before other threads start publishing.
+    void SetQueueLimits(EventPriority p, uint32 capacity, EventOverflowPolicy policy)
+    {
+        for (uint32 q = 0; q < NUM_QUEUES; q++)
+            m_queues[(uint32)p][q].SetCapacity(capacity);
+        m_lanes[(uint32)p].policy   = policy;
+        m_lanes[(uint32)p].capacity = m_queues[(uint32)p][0].Capacity();
+    }
+
+    // Events that can be waiting for Update() from PublishThreadSafe(); 0,
+    // the default, for no limit.
+    // @warning Call before other threads start publishing.
+    void SetThreadSafeCapacity(uint32 capacity) { m_threadSafeCapacity = capacity; }
+
+    EventQueueStats QueueStats(EventPriority p) const
+    {
+        EventQueueStats s;
+        s.capacity  = m_queues[(uint32)p][m_activeQueue].Capacity();
+        s.size      = m_queues[(uint32)p][m_activeQueue].Size();
+        s.highWater = m_lanes[(uint32)p].highWater;
+        s.overflows = m_lanes[(uint32)p].overflows;
+        return s;
+    }
+
+    EventQueueStats ThreadSafeQueueStats() const
+    {
+        EventQueueStats s;
+        s.capacity  = m_threadSafeCapacity;
+        s.size      = m_threadSafeCount.load(std::memory_order_relaxed);
+        s.highWater = m_threadSafeHighWater.load(std::memory_order_relaxed);
+        s.overflows = m_threadSafeOverflows.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // When Update() runs out of time and more than backlogLimit events are
+    // left, the excess is shed according to policy.
+    void SetShedding(EventShedPolicy policy, uint32 backlogLimit)
+    {
+        m_shedPolicy   = policy;
+        m_backlogLimit = backlogLimit;
+    }
+
+    // Events the last Update() ran out of time for and deferred.
+    uint32 BacklogDepth() const { return m_backlogDepth; }
+    // Times Update() has run out of time.
+    uint32 OverrunCount() const { return m_overrunCount; }
+    // Events dropped by the shedding policy.
+    uint32 ShedCount()    const { return m_shedCount;    }
+
+    // Critical events are always dispatched; the rest stop once
+    // maxMilliseconds have elapsed and are deferred to the next Update().
     void Update(bool limitTime = false, DeltaTime maxMilliseconds = 0.0f)
     {
         TimeStamp startTime = App::Time();
-        DeltaTime elapsedMilliseconds = 0.0f;
 
-        Queue& q = m_queues[m_activeQueue];
+        m_backlogDepth = 0;
+        CompactSubscribers_();
+
+        uint32      current = m_activeQueue;
+        FrameArena& arena   = m_arenas[current];
+
+        m_timers.Advance(TimerTick_(startTime), [this](EventStrongPtr&& e) { Publish(e); });
+        if (m_replayer.IsOpen())
+            Replay_();
+        m_queueGeneration++; // current's events can't be coalesced into anymore.
+
+        // Only what's there now, or producers could keep this going forever.
+        // An event whose queue is full, and everything after it, waits for
+        // the next Update().
+        uint32 threadSafeCount = m_threadSafeCount.load(std::memory_order_relaxed);
+        uint32 evictions[NUM_PRIORITIES];
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+            evictions[p] = m_threadSafeEvictions[p].exchange(0, std::memory_order_relaxed);
+        QueuedEvent_ threadSafeEvent;
+        while (threadSafeCount-- > 0 && PopThreadSafe_(threadSafeEvent))
+        {
+            EventTypeIndex i = threadSafeEvent.event->Index();
+            uint32         p = (uint32)threadSafeEvent.event->Priority();
+            if (HasSubscribers_(i) && !Suppressed_())
+            {
+                if (evictions[p] == 0 && m_queues[p][m_activeQueue].Full() &&
+                    (m_lanes[p].policy != EventOverflowPolicy::Block || !CanGrow_(m_queues[p][m_activeQueue], m_lanes[p])))
+                {
+                    m_threadSafeWaiting = std::move(threadSafeEvent);
+                    break;
+                }
+
+                Record_(*threadSafeEvent.event, EventLogRecord::FLAG_THREAD_SAFE | (evictions[p] > 0 ? EventLogRecord::FLAG_SHED : 0));
+                if (m_metricsEnabled)
+                    m_metrics[i].published++;
+                if (evictions[p] > 0)
+                    Shed_(threadSafeEvent);
+                else
+                    Enqueue_(std::move(threadSafeEvent));
+            }
+            if (evictions[p] > 0)
+                evictions[p]--;
+            m_threadSafeCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        threadSafeEvent.owner.reset();
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+        {
+            if (evictions[p] > 0) // For events published after the count was read.
+                m_threadSafeEvictions[p].fetch_add(evictions[p], std::memory_order_relaxed);
+        }
+        m_shedCount += m_threadSafeDropped.exchange(0, std::memory_order_relaxed);
+        WarnThreadSafeOverflows_(startTime);
+
         m_activeQueue++;
         if (m_activeQueue >= NUM_QUEUES)
             m_activeQueue = 0;
-        m_queues[m_activeQueue].clear();
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+            m_queues[p][m_activeQueue].Clear();
 
-        while (!q.empty())
+        bool outOfTime = false;
+        for (uint32 p = 0; p < NUM_PRIORITIES && !outOfTime; p++)
         {
-            EventStrongPtr e = q.front();
-            q.pop_front();
-
-            auto findIt = m_subscribers.find(e->Type());
-            if (findIt != m_subscribers.end())
+            Queue& q = m_queues[p][current];
+            while (!q.Empty())
             {
-                SubscriberList& l = findIt->second;
-                auto it = l.begin();
-                while (it != l.end())
+                QueuedEvent_ e = q.PopFront();
+
+                EventTypeIndex i = e.event->Index();
+                if (HasSubscribers_(i))
                 {
-                    auto thisIt = it++;
-                    SubscriberWithIDWeakPtr_& s = *thisIt;
-                    SubscriberIDStrongPtr sid = s.id.lock();
-                    if (sid)
-                        s.s(e);
+                    if (m_threadPool && m_subscribers[i].mainThreadCount == 0)
+                        DispatchConcurrent_(i, e);
                     else
-                        l.erase(thisIt);
+                        Dispatch_(i, *e.event, e.published);
+                }
+
+                if (limitTime && p != (uint32)EventPriority::Critical &&
+                    App::MillisecondsElapsed(startTime) >= maxMilliseconds)
+                {
+                    outOfTime = true;
+                    break;
+                }
+            }
+        }
+
+        // Queued events and subscribers must stay put until workers are done.
+        WaitConcurrent_();
+
+        if (outOfTime)
+            DeferRemaining_(current);
+
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+            m_queues[p][current].Clear();
+        arena.Reset();
+
+        m_frame++;
+        m_lastUpdateMilliseconds = App::MillisecondsElapsed(startTime);
+    }
+
+    // Tees every event published from outside a subscriber into file, with
+    // the Update() it's dispatched in and its publish time, until
+    // StopRecording(). Events published by subscribers aren't recorded since
+    // replaying the rest regenerates them, nor are PublishNow() events or
+    // those with no subscribers. Returns false on failure.
+    bool StartRecording(const std::string& file)
+    {
+        if (m_replayer.IsOpen())
+        {
+            LogWarning("Can't record events while replaying them.");
+            return false;
+        }
+
+        if (!m_recorder.Open(file))
+            return false;
+        m_recordStartFrame = m_frame;
+        m_recordStartTime  = App::Time();
+        return true;
+    }
+
+    void StopRecording() { m_recorder.Close(); }
+    bool IsRecording() const { return m_recorder.IsOpen(); }
+
+    // Publishes a recording's events in the same Update()s, relative to the
+    // next one, that they were originally dispatched in; events that would
+    // have been recorded are dropped meanwhile, so runs are reproducible.
+    // Stops at the end of the recording unless loop is set.
+    bool StartReplay(const std::string& file, bool loop = false)
+    {
+        if (m_recorder.IsOpen())
+        {
+            LogWarning("Can't replay events while recording them.");
+            return false;
+        }
+
+        if (!m_replayer.Open(file))
+            return false;
+        m_replayLoop       = loop;
+        m_replayStartFrame = m_frame;
+        LogInfo("Replaying events from %s.", file.c_str());
+        return true;
+    }
+
+    void StopReplay() { m_replayer.Close(); }
+    bool IsReplaying() const { return m_replayer.IsOpen(); }
+
+    // Copies every event dispatched into a shared memory ring that other
+    // processes can watch live, e.g., with ellie-tap; see event_tap.hpp.
+    // Never blocks on readers. POSIX only; returns false on failure.
+    bool StartTap(const std::string& name = EventTap::DEFAULT_NAME, uint64 capacity = MEBIBYTES(4))
+    {
+        return m_tap.Open(name, capacity, App::TimePerSecond());
+    }
+
+    void StopTap() { m_tap.Close(); }
+    bool IsTapping() const { return m_tap.IsOpen(); }
+
+    // Metrics are cheap enough to leave on; disabling skips the timestamps.
+    void SetMetricsEnabled(bool enabled) { m_metricsEnabled = enabled; }
+    bool MetricsEnabled() const { return m_metricsEnabled; }
+
+    // Indexed by EventTypeIndex; types that have never had a subscriber may
+    // be out of range.
+    uint32 MetricsCount() const { return m_metrics.size(); }
+    const EventMetrics& Metrics(EventTypeIndex i) const { return m_metrics[i]; }
+
+    void ResetMetrics()
+    {
+        for (EventMetrics& m : m_metrics)
+        {
+            const char* name = m.name;
+            m = EventMetrics();
+            m.name = name;
+        }
+    }
+
+    DeltaTime LastUpdateMilliseconds() const { return m_lastUpdateMilliseconds; }
+
+    // Writes a table of every event type's metrics; returns false on failure.
+    bool DumpMetrics(const std::string& file) const
+    {
+        std::FILE* f = std::fopen(file.c_str(), "wb");
+        if (!f)
+        {
+            LogWarning("Failed to open file: %s.", file.c_str());
+            return false;
+        }
+
+        std::fprintf(f, "%-24s %10s %10s %10s %10s %10s "
+                        "%12s %12s %12s %12s %12s %12s\n",
+                     "event", "published", "coalesced", "shed", "dispatched", "invoked",
+                     "res_mean_ms", "res_p99_ms", "res_max_ms", "hnd_mean_ms", "hnd_p99_ms", "hnd_max_ms");
+        for (const EventMetrics& m : m_metrics)
+        {
+            if (!m.name)
+                continue;
+
+            std::fprintf(f, "%-24s %10llu %10llu %10llu %10llu %10llu "
+                            "%12.4f %12.4f %12.4f %12.4f %12.4f %12.4f\n",
+                         m.name,
+                         (unsigned long long)m.published, (unsigned long long)m.coalesced,
+                         (unsigned long long)m.shed, (unsigned long long)m.dispatched,
+                         (unsigned long long)m.subscribersInvoked,
+                         m.residency.MeanMilliseconds(), m.residency.PercentileMilliseconds(0.99f), m.residency.MaxMilliseconds(),
+                         m.handler.MeanMilliseconds(),   m.handler.PercentileMilliseconds(0.99f),   m.handler.MaxMilliseconds());
+        }
+
+        bool ok = !std::ferror(f);
+        std::fclose(f);
+        if (!ok)
+            LogWarning("Failed to write file: %s.", file.c_str());
+        return ok;
+    }
+
+private:
+    // Handlers are called through a plain function pointer; call casts
+    // target and the event back to the types they were subscribed with.
+    typedef void (*SubscriberCall_)(void* target, IEvent& e);
+
+    struct Subscriber_
+    {
+        SubscriberCall_       call; // nullptr once unsubscribed.
+        void*                 target;
+        std::shared_ptr<void> storage; // Owns target, if it's a callable.
+        uint32                slot;
+        bool                  concurrent;
+    };
+
+    // Unsubscribing leaves a tombstone (call == nullptr) so lists never
+    // change while being walked; they're compacted once per Update().
+    struct SubscriberList_
+    {
+        std::vector<Subscriber_> subscribers;
+        bool hasTombstones = false;
+
+        // Live subscribers by EventDispatch.
+        uint32 mainThreadCount = 0;
+        uint32 concurrentCount = 0;
+    };
+
+    // Indexed by EventTypeIndex; each type's subscribers are contiguous.
+    typedef std::vector<SubscriberList_> SubscriberTable;
+
+    static const uint32 INVALID_INDEX = 0xFFFFFFFF;
+
+    // Slot map entry; position is the subscriber's index in its type's list,
+    // or INVALID_INDEX while it's pending or the slot is free.
+    struct SubscriberSlot_
+    {
+        uint32         generation = 0;
+        bool           live       = false;
+        EventTypeIndex type       = 0;
+        uint32         position   = INVALID_INDEX;
+        uint32         nextFree   = INVALID_INDEX;
+    };
+
+    // owner is null for events constructed in the queue's arena; published
+    // is 0 when metrics are disabled.
+    struct QueuedEvent_
+    {
+        IEvent*        event = nullptr;
+        EventStrongPtr owner;
+        TimeStamp      published = 0;
+    };
+
+    typedef RingBuffer<QueuedEvent_> Queue;
+
+    static const uint32 NUM_QUEUES     = 2; // Must be 2+.
+    static const uint32 NUM_PRIORITIES = (uint32)EventPriority::Count;
+
+    SubscriberTable m_subscribers;
+
+    std::vector<SubscriberSlot_> m_slots;
+    uint32 m_firstFreeSlot = INVALID_INDEX;
+
+    // Subscriber lists never grow during dispatch; subscriptions made by
+    // subscribers while they're being called are added afterwards.
+    uint32 m_dispatchDepth = 0;
+    std::vector<std::pair<Subscriber_, uint32>> m_pendingSubscribers; // With slot generation.
+    std::vector<EventTypeIndex> m_tombstonedTypes;
+
+    // Events for Concurrent subscribers are handed to the pool in batches.
+    // While any are in flight, m_dispatchDepth is held up so subscriber lists
+    // don't grow, and Concurrent subscribers' unsubscriptions are deferred so
+    // their tombstones aren't written while workers read them.
+    static const uint32 CONCURRENT_BATCH_SIZE = 32;
+
+    ThreadPool*               m_threadPool = nullptr;
+    ThreadPool::TaskGroup     m_concurrentTasks;
+    std::vector<QueuedEvent_> m_concurrentBatch;
+    bool                      m_concurrentInFlight = false;
+    std::vector<SubscriberHandle> m_deferredUnsubscribes;
+
+    // Shared by a priority's queue pair.
+    struct Lane_
+    {
+        EventOverflowPolicy policy     = EventOverflowPolicy::DropOldest;
+        uint32              capacity   = 0; // As configured, rounded up.
+        uint32              highWater  = 0;
+        uint64              overflows  = 0;
+        uint64              blockDrops = 0; // Past a Block queue's limit.
+    };
+    Lane_ m_lanes[NUM_PRIORITIES];
+
+    // One queue pair per priority. Events published to m_queues[p][i] that
+    // aren't shared live in m_arenas[i].
+    Queue      m_queues[NUM_PRIORITIES][NUM_QUEUES];
+    FrameArena m_arenas[NUM_QUEUES];
+    uint32     m_activeQueue = 0;
+
+    // Indexed by EventTypeIndex. queued is the arena event that events of the
+    // same type are merged into; only valid while generation matches.
+    struct Coalescing_
+    {
+        Coalescer coalescer;
+        IEvent*   queued     = nullptr;
+        uint32    generation = 0;
+    };
+    std::vector<Coalescing_> m_coalescing;
+    uint32 m_queueGeneration = 0;
+
+    EventShedPolicy m_shedPolicy   = EventShedPolicy::Keep;
+    uint32          m_backlogLimit = 0;
+    uint32          m_backlogDepth = 0;
+    uint32          m_overrunCount = 0;
+    uint32          m_shedCount    = 0;
+
+    // Events published from other threads; drained by Update(). Waiting is
+    // the first one that didn't fit in its queue, if any, and is counted.
+    MPSCQueue<QueuedEvent_> m_threadSafeQueue;
+    QueuedEvent_        m_threadSafeWaiting;
+    uint32              m_threadSafeCapacity = 0;
+    std::atomic<uint32> m_threadSafeCount{0};
+    std::atomic<uint32> m_threadSafeHighWater{0};
+    std::atomic<uint64> m_threadSafeOverflows{0};
+    std::atomic<uint32> m_threadSafeEvictions[NUM_PRIORITIES] = {}; // Oldest events of each to drop.
+    std::atomic<uint32> m_threadSafeDropped{0}; // Newest events dropped, for ShedCount().
+    uint64              m_threadSafeOverflowsLogged = 0;
+    TimeStamp           m_threadSafeOverflowsLogTime = 0;
+    std::thread::id     m_ownerThread = std::this_thread::get_id();
+
+    // Indexed by EventTypeIndex; kept at least as large as m_subscribers, so
+    // it never grows during dispatch.
+    std::vector<EventMetrics> m_metrics;
+    bool      m_metricsEnabled         = true;
+    DeltaTime m_lastUpdateMilliseconds = 0.0f;
+
+    uint32 m_frame = 0; // Update()s so far.
+
+    // Ticks are milliseconds.
+    TimeStamp                  m_timerTickLength; // In App::Time() units.
+    TimerWheel<EventStrongPtr> m_timers;
+
+    EventRecorder m_recorder;
+    uint32        m_recordStartFrame = 0;
+    TimeStamp     m_recordStartTime  = 0;
+
+    EventReplayer m_replayer;
+    uint32        m_replayStartFrame = 0;
+    bool          m_replayLoop       = false;
+
+    EventTap m_tap;
+
+    Subscription Subscribe_(EventTypeIndex i, SubscriberCall_ call, void* target, std::shared_ptr<void> storage, EventDispatch dispatch)
+    {
+        uint32 slot = m_firstFreeSlot;
+        if (slot == INVALID_INDEX)
+        {
+            slot = m_slots.size();
+            m_slots.push_back(SubscriberSlot_());
+        }
+        else
+        {
+            m_firstFreeSlot = m_slots[slot].nextFree;
+        }
+
+        SubscriberSlot_& ss = m_slots[slot];
+        ss.live     = true;
+        ss.type     = i;
+        ss.position = INVALID_INDEX;
+        ss.nextFree = INVALID_INDEX;
+
+        Subscriber_ s;
+        s.call    = call;
+        s.target  = target;
+        s.storage    = std::move(storage);
+        s.slot       = slot;
+        s.concurrent = (dispatch == EventDispatch::Concurrent);
+
+        if (m_dispatchDepth > 0)
+            m_pendingSubscribers.push_back(std::make_pair(std::move(s), ss.generation));
+        else
+            AddSubscriber_(std::move(s));
+
+        SubscriberHandle h;
+        h.index      = slot;
+        h.generation = ss.generation;
+        return Subscription(this, h);
+    }
+
+    void AddSubscriber_(Subscriber_&& s)
+    {
+        SubscriberSlot_& ss = m_slots[s.slot];
+        if (ss.type >= m_subscribers.size())
+            m_subscribers.resize(ss.type + 1);
+
+        if (ss.type >= m_metrics.size())
+            m_metrics.resize(ss.type + 1);
+
+        SubscriberList_& l = m_subscribers[ss.type];
+        if (s.concurrent)
+            l.concurrentCount++;
+        else
+            l.mainThreadCount++;
+        ss.position = l.subscribers.size();
+        l.subscribers.push_back(std::move(s));
+    }
+
+    void Unsubscribe_(SubscriberHandle h)
+    {
+        if (h.index >= m_slots.size())
+            return;
+        SubscriberSlot_& ss = m_slots[h.index];
+        if (!ss.live || ss.generation != h.generation)
+            return;
+
+        if (ss.position != INVALID_INDEX)
+        {
+            SubscriberList_& l = m_subscribers[ss.type];
+            Subscriber_& s = l.subscribers[ss.position];
+            if (s.concurrent)
+            {
+                if (m_concurrentInFlight)
+                {
+                    m_deferredUnsubscribes.push_back(h);
+                    return;
+                }
+                l.concurrentCount--;
+            }
+            else
+            {
+                l.mainThreadCount--;
+            }
+
+            s.call = nullptr;
+            // Don't release storage here; it may be the callable being run.
+            if (!l.hasTombstones)
+            {
+                l.hasTombstones = true;
+                m_tombstonedTypes.push_back(ss.type);
+            }
+        }
+        // else it's still in m_pendingSubscribers, which checks live.
+
+        ss.live     = false;
+        ss.position = INVALID_INDEX;
+        ss.generation++;
+        ss.nextFree = m_firstFreeSlot;
+        m_firstFreeSlot = h.index;
+    }
+
+    void CompactSubscribers_()
+    {
+        for (EventTypeIndex i : m_tombstonedTypes)
+        {
+            SubscriberList_& l = m_subscribers[i];
+            std::vector<Subscriber_>& v = l.subscribers;
+            uint32 out = 0;
+            for (uint32 in = 0; in < v.size(); in++)
+            {
+                if (!v[in].call)
+                    continue;
+                if (out != in)
+                    v[out] = std::move(v[in]);
+                m_slots[v[out].slot].position = out;
+                out++;
+            }
+            v.resize(out);
+            l.hasTombstones = false;
+        }
+        m_tombstonedTypes.clear();
+    }
+
+    static void CallSubscriber_(void* target, IEvent& e)
+    {
+        (*static_cast<Subscriber*>(target))(e);
+    }
+
+    template<class EventT, class T, auto Handler>
+    static void CallMember_(void* target, IEvent& e)
+    {
+        (static_cast<T*>(target)->*Handler)(static_cast<const EventT&>(e));
+    }
+
+    template<class EventT, void (*Handler)(const EventT&)>
+    static void CallFunction_(void* /*target*/, IEvent& e)
+    {
+        Handler(static_cast<const EventT&>(e));
+    }
+
+    template<class EventT, class Callable>
+    static void CallCallable_(void* target, IEvent& e)
+    {
+        (*static_cast<Callable*>(target))(static_cast<const EventT&>(e));
+    }
+
+    bool HasSubscribers_(EventTypeIndex i) const
+    {
+        return i < m_subscribers.size() && !m_subscribers[i].subscribers.empty();
+    }
+
+    IEvent* CoalesceTarget_(EventTypeIndex i) const
+    {
+        if (i >= m_coalescing.size())
+            return nullptr;
+
+        const Coalescing_& c = m_coalescing[i];
+        if (c.coalescer && c.queued && c.generation == m_queueGeneration)
+            return c.queued;
+        return nullptr;
+    }
+
+    // Queues e at the back of its priority's active queue, applying the
+    // overflow policy if it's full. Returns false if e isn't queued by itself
+    // afterwards, i.e., it was dropped or merged.
+    bool Enqueue_(QueuedEvent_&& e)
+    {
+        uint32 p = (uint32)e.event->Priority();
+        Queue& q = m_queues[p][m_activeQueue];
+        Lane_& lane = m_lanes[p];
+
+        if (q.Full())
+        {
+            lane.overflows++;
+            switch (lane.policy)
+            {
+                case EventOverflowPolicy::DropNewest:
+                    Shed_(e);
+                    return false;
+
+                case EventOverflowPolicy::Coalesce:
+                    if (CoalesceQueued_(q, e))
+                        return false;
+                    Shed_(q.PopFront());
+                    break;
+
+                case EventOverflowPolicy::DropOldest:
+                    Shed_(q.PopFront());
+                    break;
+
+                case EventOverflowPolicy::Block:
+                    if (CanGrow_(q, lane))
+                    {
+                        q.Grow();
+                        LogWarning("Event queue full; grew it to %u.", q.Capacity());
+                        break;
+                    }
+                    // DropNewest past the limit; warned at every power of two.
+                    lane.blockDrops++;
+                    if ((lane.blockDrops & (lane.blockDrops - 1)) == 0)
+                        LogWarning("Event queue full at its limit of %u; %llu events dropped.",
+                                   q.Capacity(), (unsigned long long)lane.blockDrops);
+                    Shed_(e);
+                    return false;
+            }
+        }
+
+        q.PushBack(std::move(e));
+        if (q.Size() > lane.highWater)
+            lane.highWater = q.Size();
+        return true;
+    }
+
+    static bool CanGrow_(const Queue& q, const Lane_& lane) { return q.Capacity() < lane.capacity * BLOCK_GROWTH_LIMIT; }
+
+    // Merges e into the newest event of its type in q; false if there's none.
+    // Only on overflow, so the linear search is fine.
+    bool CoalesceQueued_(Queue& q, QueuedEvent_& e)
+    {
+        EventTypeIndex i = e.event->Index();
+        for (uint32 n = q.Size(); n-- > 0;)
+        {
+            QueuedEvent_& queued = q[n];
+            if (queued.event->Index() != i)
+                continue;
+
+            if (i < m_coalescing.size() && m_coalescing[i].coalescer)
+            {
+                // A shared event may be held by its publisher, so merge into
+                // a copy of it in the arena, which later events merge into.
+                if (queued.owner)
+                {
+                    IEvent* copy = queued.event->CopyInto(m_arenas[m_activeQueue]);
+                    if (!copy)
+                        return false;
+                    queued.event = copy;
+                    queued.owner.reset();
+                    m_coalescing[i].queued     = copy;
+                    m_coalescing[i].generation = m_queueGeneration;
+                }
+                m_coalescing[i].coalescer(*queued.event, *e.event);
+            }
+            else
+            {
+                // Keep the latest, in the older one's place.
+                queued.event = e.event;
+                queued.owner = std::move(e.owner);
+            }
+
+            if (m_metricsEnabled)
+                m_metrics[i].coalesced++;
+            return true;
+        }
+        return false;
+    }
+
+    // The event left waiting by the last Update() first.
+    bool PopThreadSafe_(QueuedEvent_& e)
+    {
+        if (!m_threadSafeWaiting.event)
+            return m_threadSafeQueue.Pop(e);
+        e = std::move(m_threadSafeWaiting);
+        m_threadSafeWaiting.event = nullptr;
+        m_threadSafeWaiting.owner.reset();
+        return true;
+    }
+
+    // At most once a second, so a flood doesn't flood the log too.
+    void WarnThreadSafeOverflows_(TimeStamp now)
+    {
+        uint64 overflows = m_threadSafeOverflows.load(std::memory_order_relaxed);
+        if (overflows == m_threadSafeOverflowsLogged ||
+            (m_threadSafeOverflowsLogTime != 0 && now - m_threadSafeOverflowsLogTime < App::TimePerSecond()))
+            return;
+
+        LogWarning("%llu thread-safe events overflowed the capacity of %u.",
+                   (unsigned long long)(overflows - m_threadSafeOverflowsLogged), m_threadSafeCapacity);
+        m_threadSafeOverflowsLogged  = overflows;
+        m_threadSafeOverflowsLogTime = now;
+    }
+
+    // Dropped arena events are destroyed when their arena is reset.
+    void Shed_(const QueuedEvent_& e)
+    {
+        EventTypeIndex i = e.event->Index();
+        if (i < m_coalescing.size() && m_coalescing[i].queued == e.event)
+            m_coalescing[i].queued = nullptr;
+
+        if (m_metricsEnabled)
+            m_metrics[i].shed++;
+        m_shedCount++;
+    }
+
+    static TimeStamp TimerTickLength_()
+    {
+        TimeStamp length = App::TimePerSecond() / 1000;
+        return (length ? length : 1);
+    }
+
+    uint64 TimerTick_(TimeStamp time) const { return time / m_timerTickLength; }
+
+    // e must be in the active queue's arena.
+    void QueueArenaEvent_(EventTypeIndex i, IEvent* e)
+    {
+        if (!Enqueue_(QueuedEvent_{e, nullptr, PublishTime_()}))
+            return;
+
+        if (i < m_coalescing.size() && m_coalescing[i].coalescer)
+        {
+            m_coalescing[i].queued     = e;
+            m_coalescing[i].generation = m_queueGeneration;
+        }
+    }
+
+    // Live events that would be recorded are dropped while replaying.
+    bool Suppressed_() const { return m_dispatchDepth == 0 && m_replayer.IsOpen(); }
+
+    void Record_(const IEvent& e, uint32 flags = 0)
+    {
+        if (m_dispatchDepth > 0 || !m_recorder.IsOpen())
+            return;
+
+        EventLogRecord r;
+        r.frame    = m_frame - m_recordStartFrame;
+        r.type     = e.Type();
+        r.time     = App::Time() - m_recordStartTime;
+        r.size     = e.PayloadSize();
+        r.flags    = flags;
+        m_recorder.Write(r, e.Payload());
+    }
+
+    // Publishes the recorded events for this Update().
+    void Replay_()
+    {
+        EventLogRecord r;
+        const void*    payload;
+        uint32         frame = m_frame - m_replayStartFrame;
+        while (true)
+        {
+            if (!m_replayer.Peek(r, payload))
+            {
+                m_replayer.Rewind();
+                if (!m_replayLoop || !m_replayer.Peek(r, payload))
+                {
+                    LogInfo("Finished replaying events.");
+                    m_replayer.Close();
+                    return;
                 }
+
+                // Pick up from the start of the recording next Update().
+                m_replayStartFrame = m_frame + 1;
+                return;
+            }
+
+            if (r.frame > frame)
+                return;
+            m_replayer.Advance();
+
+            // Types never used in this run can't have subscribers.
+            EventReplayFunction replay = EventTypes::ReplayFunction(r.type);
+            if (!replay)
+                continue;
+
+            IEvent* e = replay(m_arenas[m_activeQueue], payload, r.size);
+            if (!e)
+            {
+                LogWarning("Failed to replay an event of type %08X; dropped.", (unsigned)r.type);
+                continue;
+            }
+
+            EventTypeIndex i = e->Index();
+            if (!HasSubscribers_(i))
+                continue;
+
+            if (m_metricsEnabled)
+                m_metrics[i].published++;
+
+            IEvent* target = CoalesceTarget_(i);
+            if (r.flags & EventLogRecord::FLAG_SHED)
+            {
+                Shed_(QueuedEvent_{e, nullptr, 0});
+            }
+            else if (r.flags & EventLogRecord::FLAG_THREAD_SAFE)
+            {
+                Enqueue_(QueuedEvent_{e, nullptr, PublishTime_()});
+            }
+            else if (target)
+            {
+                m_coalescing[i].coalescer(*target, *e);
+                if (m_metricsEnabled)
+                    m_metrics[i].coalesced++;
+            }
+            else
+            {
+                QueueArenaEvent_(i, e);
+            }
+        }
+    }
+
+    TimeStamp PublishTime_() const { return (m_metricsEnabled ? App::Time() : 0); }
+
+    // Moves what's left in queue index current to the front of the active
+    // queues, after shedding the excess; lowest priorities are shed first.
+    void DeferRemaining_(uint32 current)
+    {
+        uint32 remaining = 0;
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+            remaining += m_queues[p][current].Size();
+        if (remaining == 0)
+            return;
+
+        m_overrunCount++;
+
+        if (m_shedPolicy != EventShedPolicy::Keep && remaining > m_backlogLimit)
+        {
+            uint32 excess = remaining - m_backlogLimit;
+            uint32 shed   = 0;
+            for (uint32 p = NUM_PRIORITIES - 1; p > (uint32)EventPriority::Critical && shed < excess; p--)
+            {
+                Queue& q = m_queues[p][current];
+                uint32 n = excess - shed;
+                if (n > q.Size())
+                    n = q.Size();
+
+                for (uint32 k = 0; k < n; k++)
+                    Shed_(m_shedPolicy == EventShedPolicy::DropOldest ? q.PopFront() : q.PopBack());
+                shed += n;
             }
 
-            if (limitTime && !q.empty())
+            remaining -= shed;
+            LogWarning("Event backlog over %u; shed %u events.", m_backlogLimit, shed);
+        }
+
+        m_backlogDepth = remaining;
+        LogWarning("Aborting event processing; ran out of time with %u events left.", remaining);
+
+        FrameArena& nextArena = m_arenas[m_activeQueue];
+        for (uint32 p = 0; p < NUM_PRIORITIES; p++)
+        {
+            Queue& q     = m_queues[p][current];
+            Queue& nextQ = m_queues[p][m_activeQueue];
+            while (!q.Empty())
             {
-                elapsedMilliseconds += App::MillisecondsElapsed(startTime);
-                if (elapsedMilliseconds >= maxMilliseconds)
+                QueuedEvent_ e = q.PopBack();
+
+                // current's arena is about to be reset, so move its events
+                // into the arena of the queue they're deferred to.
+                if (!e.owner)
                 {
-                    LogWarning("Aborting event processing; ran out of time.");
-                    Queue& nextQ = m_queues[m_activeQueue];
-                    while (!q.empty())
+                    e.event = e.event->MoveInto(nextArena);
+                    if (!e.event)
                     {
-                        // reuse e
-                        e = q.back();
-                        q.pop_back();
-                        nextQ.push_front(e);
+                        LogWarning("Failed to allocate memory for a deferred event; dropped.");
+                        continue;
                     }
+                }
 
-                    break;
+                // Deferred events are older than anything in nextQ.
+                if (nextQ.Full())
+                {
+                    m_lanes[p].overflows++;
+                    if (m_lanes[p].policy == EventOverflowPolicy::Block && CanGrow_(nextQ, m_lanes[p]))
+                    {
+                        nextQ.Grow();
+                    }
+                    else if (m_lanes[p].policy == EventOverflowPolicy::Block || m_lanes[p].policy == EventOverflowPolicy::DropNewest)
+                    {
+                        Shed_(nextQ.PopBack());
+                    }
+                    else
+                    {
+                        Shed_(e);
+                        continue;
+                    }
                 }
+                nextQ.PushFront(std::move(e));
+                if (nextQ.Size() > m_lanes[p].highWater)
+                    m_lanes[p].highWater = nextQ.Size();
             }
         }
     }
 
-private:
-    struct SubscriberWithIDWeakPtr_
+    // published is the event's publish time, or 0 if it wasn't queued.
+    void Dispatch_(EventTypeIndex i, IEvent& e, TimeStamp published = 0)
     {
-        SubscriberIDWeakPtr id;
-        Subscriber s;
-    };
+        if (m_tap.IsOpen())
+            Tap_(e);
 
-    typedef std::list<SubscriberWithIDWeakPtr_> SubscriberList;
-    typedef std::map<UUID, SubscriberList>      SubscriberMap;
+        m_dispatchDepth++;
 
-    typedef std::list<EventStrongPtr> Queue;
+        if (m_metricsEnabled)
+        {
+            EventMetrics& m = m_metrics[i];
+            if (!m.name)
+                m.name = e.Name();
+            m.dispatched++;
 
-    static const uint32 NUM_QUEUES = 2; // Must be 2+.
+            TimeStamp t = App::Time();
+            if (published)
+                m.residency.Record(t - published);
 
-    SubscriberID  m_nextSubscriberID = 0;
-    SubscriberMap m_subscribers;
+            for (const Subscriber_& s : m_subscribers[i].subscribers)
+            {
+                if (s.call)
+                {
+                    s.call(s.target, e);
 
-    Queue  m_queues[NUM_QUEUES];
-    uint32 m_activeQueue = 0;
+                    TimeStamp now = App::Time();
+                    m.handler.Record(now - t);
+                    m.subscribersInvoked++;
+                    t = now;
+                }
+            }
+        }
+        else
+        {
+            for (const Subscriber_& s : m_subscribers[i].subscribers)
+            {
+                if (s.call)
+                    s.call(s.target, e);
+            }
+        }
 
-    SubscriberID NewSubscriberID()
+        m_dispatchDepth--;
+        if (m_dispatchDepth == 0)
+            AddPendingSubscribers_();
+    }
+
+    void Tap_(const IEvent& e)
+    {
+        m_tap.Write(e.Type(), e.Name(), m_frame, App::Time(), e.Payload(), e.PayloadSize());
+    }
+
+    void AddPendingSubscribers_()
+    {
+        for (auto& p : m_pendingSubscribers)
+        {
+            const SubscriberSlot_& ss = m_slots[p.first.slot];
+            if (ss.live && ss.generation == p.second)
+                AddSubscriber_(std::move(p.first));
+        }
+        m_pendingSubscribers.clear();
+    }
+
+    // Only Update() calls this, for events whose subscribers are all
+    // Concurrent.
+    void DispatchConcurrent_(EventTypeIndex i, const QueuedEvent_& e)
     {
-        // @todo Reuse ids and actually FAIL when we're out.
+        if (m_tap.IsOpen())
+            Tap_(*e.event);
+
+        if (m_metricsEnabled)
+        {
+            // Handler times aren't recorded; the histogram isn't thread-safe.
+            EventMetrics& m = m_metrics[i];
+            if (!m.name)
+                m.name = e.event->Name();
+            m.dispatched++;
+            m.subscribersInvoked += m_subscribers[i].concurrentCount;
+            if (e.published)
+                m.residency.Record(App::Time() - e.published);
+        }
+
+        if (!m_concurrentInFlight)
+        {
+            m_concurrentInFlight = true;
+            m_dispatchDepth++;
+        }
+
+        m_concurrentBatch.push_back(e);
+        if (m_concurrentBatch.size() >= CONCURRENT_BATCH_SIZE)
+            SubmitConcurrentBatch_();
+    }
+
+    void SubmitConcurrentBatch_()
+    {
+        m_threadPool->Submit(m_concurrentTasks, [this, batch = std::move(m_concurrentBatch)]
+        {
+            for (const QueuedEvent_& e : batch)
+            {
+                for (const Subscriber_& s : m_subscribers[e.event->Index()].subscribers)
+                {
+                    if (s.call)
+                        s.call(s.target, *e.event);
+                }
+            }
+        });
+        m_concurrentBatch.clear();
+    }
+
+    // The barrier between Update()'s concurrent dispatch and the rest of the
+    // frame.
+    void WaitConcurrent_()
+    {
+        if (!m_concurrentInFlight)
+            return;
+
+        if (!m_concurrentBatch.empty())
+            SubmitConcurrentBatch_();
+        m_threadPool->Wait(m_concurrentTasks);
+
+        m_concurrentInFlight = false;
+        m_dispatchDepth--;
+        AddPendingSubscribers_();
 
-        SubscriberID r = m_nextSubscriberID++;
-        if (m_nextSubscriberID == 0)
-            LogFatal("Ran out of subscriber ids; weirdness and crashes are likely.");
-        return r;
+        std::vector<SubscriberHandle> deferred;
+        deferred.swap(m_deferredUnsubscribes);
+        for (SubscriberHandle h : deferred)
+            Unsubscribe_(h);
     }
 };
 
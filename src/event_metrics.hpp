@@ -0,0 +1,111 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef EVENT_METRICS_HPP
+#define EVENT_METRICS_HPP
+
+#include "global.hpp"
+#include "app.hpp"
+
+// Power-of-two histogram of App::Time() intervals; recording is a couple of
+// instructions, so it can stay on in release builds.
+class TimeHistogram
+{
+public:
+    static const uint32 NUM_BUCKETS = 64;
+
+    void Record(TimeStamp ticks)
+    {
+        m_buckets[Bucket_(ticks)]++;
+        m_count++;
+        m_sum += ticks;
+        if (ticks > m_max)
+            m_max = ticks;
+    }
+
+    void Reset() { *this = TimeHistogram(); }
+
+    uint64 Count() const { return m_count; }
+
+    DeltaTime MeanMilliseconds() const { return m_count ? ToMilliseconds_(m_sum) / (DeltaTime)m_count : 0.0f; }
+    DeltaTime MaxMilliseconds()  const { return ToMilliseconds_(m_max); }
+
+    // Upper bound of the bucket holding the p-th (0..1) percentile.
+    DeltaTime PercentileMilliseconds(float32 p) const
+    {
+        if (m_count == 0)
+            return 0.0f;
+
+        uint64 rank = (uint64)(p * (float32)m_count);
+        if (rank >= m_count)
+            rank = m_count - 1;
+
+        uint64 seen = 0;
+        for (uint32 b = 0; b < NUM_BUCKETS; b++)
+        {
+            seen += m_buckets[b];
+            if (seen > rank)
+            {
+                TimeStamp upper = (b == 0 ? 0 : ((TimeStamp)1 << b) - 1);
+                return ToMilliseconds_(upper < m_max ? upper : m_max);
+            }
+        }
+        return MaxMilliseconds();
+    }
+
+private:
+    uint64    m_buckets[NUM_BUCKETS] = {};
+    uint64    m_count = 0;
+    TimeStamp m_sum   = 0;
+    TimeStamp m_max   = 0;
+
+    // Bucket b holds [2^(b-1), 2^b); bucket 0 holds 0.
+    static uint32 Bucket_(TimeStamp ticks)
+    {
+        if (ticks == 0)
+            return 0;
+        #if defined(COMPILER_CLANG) || defined(COMPILER_GCC) || defined(COMPILER_MINGW)
+            uint32 b = 64 - __builtin_clzll(ticks);
+        #else
+            uint32 b = 0;
+            while (ticks)
+            {
+                ticks >>= 1;
+                b++;
+            }
+        #endif
+        return (b < NUM_BUCKETS ? b : NUM_BUCKETS - 1);
+    }
+
+    static DeltaTime ToMilliseconds_(TimeStamp ticks) { return (DeltaTime)ticks * 1000.0f / (DeltaTime)App::TimePerSecond(); }
+};
+
+// Per event type; see EventBus::Metrics().
+struct EventMetrics
+{
+    const char* name = nullptr; // Unknown until the first dispatch.
+
+    uint64 published          = 0; // Queued or dispatched immediately.
+    uint64 coalesced          = 0; // Merged into a queued event instead of queued.
+    uint64 shed               = 0; // Dropped by the shedding policy.
+    uint64 dispatched         = 0;
+    uint64 subscribersInvoked = 0;
+
+    TimeHistogram residency; // Publish to dispatch.
+    TimeHistogram handler;   // Per subscriber call.
+};
+
+// Per priority queue; see EventBus::QueueStats().
+struct EventQueueStats
+{
+    uint32 capacity  = 0;
+    uint32 size      = 0;
+    uint32 highWater = 0; // Most events ever queued at once.
+    uint64 overflows = 0; // Events published while the queue was full.
+};
+
+#endif // EVENT_METRICS_HPP
@@ -0,0 +1,236 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "event_recorder.hpp"
+#include "app.hpp"
+
+#include <cstring> // memcpy
+
+bool EventRecorder::Open(const std::string& file)
+{
+    Close();
+
+    m_file = std::fopen(file.c_str(), "wb");
+    if (!m_file)
+    {
+        LogWarning("Failed to open file: %s.", file.c_str());
+        return false;
+    }
+    m_path = file;
+
+    EventLogHeader h;
+    h.magic         = EventLogHeader::MAGIC;
+    h.version       = EventLogHeader::VERSION;
+    h.timePerSecond = App::TimePerSecond();
+    if (std::fwrite(&h, sizeof(h), 1, m_file) != 1)
+    {
+        LogWarning("Failed to write file: %s.", m_path.c_str());
+        Close();
+        return false;
+    }
+
+    LogInfo("Recording events to %s.", m_path.c_str());
+    return true;
+}
+
+void EventRecorder::Close()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+        LogInfo("Stopped recording events to %s.", m_path.c_str());
+    }
+}
+
+bool EventRecorder::Write(const EventLogRecord& r, const void* payload)
+{
+    static const uint8 padding[8] = {};
+
+    if (!m_file)
+        return false;
+
+    uint32 paddingSize = (8 - (r.size & 7)) & 7;
+    if (std::fwrite(&r, sizeof(r), 1, m_file) != 1 ||
+        (r.size && std::fwrite(payload, r.size, 1, m_file) != 1) ||
+        (paddingSize && std::fwrite(padding, paddingSize, 1, m_file) != 1))
+    {
+        LogWarning("Failed to write file: %s.", m_path.c_str());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool EventReplayer::Peek(EventLogRecord& r, const void*& payload) const
+{
+    if (!m_data || m_cursor + sizeof(EventLogRecord) > m_size)
+        return false;
+
+    std::memcpy(&r, m_data + m_cursor, sizeof(r));
+    if (m_cursor + sizeof(EventLogRecord) + r.size > m_size)
+    {
+        LogWarning("Event log is truncated.");
+        return false;
+    }
+
+    payload = m_data + m_cursor + sizeof(EventLogRecord);
+    return true;
+}
+
+void EventReplayer::Advance()
+{
+    EventLogRecord r;
+    std::memcpy(&r, m_data + m_cursor, sizeof(r));
+    m_cursor += sizeof(EventLogRecord) + PaddedSize_(r.size);
+}
+
+#if defined(OS_WINDOWS)
+
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+
+    bool EventReplayer::Open(const std::string& file)
+    {
+        Close();
+
+        HANDLE f = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (f == INVALID_HANDLE_VALUE)
+        {
+            LogWarning("Failed to open file: %s.", file.c_str());
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(f, &size) || size.QuadPart < (LONGLONG)sizeof(EventLogHeader))
+        {
+            LogWarning("Event log is too small: %s.", file.c_str());
+            CloseHandle(f);
+            return false;
+        }
+
+        HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(f);
+        if (!m)
+        {
+            LogWarning("Failed to map file: %s.", file.c_str());
+            return false;
+        }
+
+        const void* data = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            LogWarning("Failed to map file: %s.", file.c_str());
+            CloseHandle(m);
+            return false;
+        }
+
+        m_data    = (const uint8*)data;
+        m_size    = size.QuadPart;
+        m_mapping = m;
+
+        EventLogHeader h;
+        std::memcpy(&h, m_data, sizeof(h));
+        if (h.magic != EventLogHeader::MAGIC || h.version != EventLogHeader::VERSION)
+        {
+            LogWarning("Not a supported event log: %s.", file.c_str());
+            Close();
+            return false;
+        }
+
+        Rewind();
+        return true;
+    }
+
+    void EventReplayer::Close()
+    {
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+
+        if (m_mapping)
+        {
+            CloseHandle((HANDLE)m_mapping);
+            m_mapping = nullptr;
+        }
+
+        m_size   = 0;
+        m_cursor = 0;
+    }
+
+#elif defined(OS_LINUX)
+
+    #include <fcntl.h> // open
+    #include <sys/mman.h> // mmap/munmap
+    #include <sys/stat.h> // fstat
+    #include <unistd.h> // close
+
+    bool EventReplayer::Open(const std::string& file)
+    {
+        Close();
+
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            LogWarning("Failed to open file: %s.", file.c_str());
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(EventLogHeader))
+        {
+            LogWarning("Event log is too small: %s.", file.c_str());
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            LogWarning("Failed to map file: %s.", file.c_str());
+            return false;
+        }
+        // Replay walks the log front to back.
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        m_data = (const uint8*)data;
+        m_size = st.st_size;
+
+        EventLogHeader h;
+        std::memcpy(&h, m_data, sizeof(h));
+        if (h.magic != EventLogHeader::MAGIC || h.version != EventLogHeader::VERSION)
+        {
+            LogWarning("Not a supported event log: %s.", file.c_str());
+            Close();
+            return false;
+        }
+
+        Rewind();
+        return true;
+    }
+
+    void EventReplayer::Close()
+    {
+        if (m_data)
+        {
+            munmap((void*)m_data, m_size);
+            m_data = nullptr;
+        }
+
+        m_size   = 0;
+        m_cursor = 0;
+    }
+
+#else
+
+    #error Unknown OS.
+
+#endif // OS_WINDOWS.
@@ -0,0 +1,87 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef EVENT_RECORDER_HPP
+#define EVENT_RECORDER_HPP
+
+// Binary event log used by EventBus::StartRecording()/StartReplay().
+//
+// Layout (native endianness): EventLogHeader, then one EventLogRecord per
+// event, each followed by its payload padded to 8 bytes.
+
+#include "global.hpp"
+
+#include <cstdio>
+#include <string>
+
+struct EventLogHeader
+{
+    static const uint32 MAGIC   = 0x56454C45; // "ELEV"
+    static const uint32 VERSION = 1;
+
+    uint32 magic;
+    uint32 version;
+    uint64 timePerSecond; // App::TimePerSecond() of the recording.
+};
+
+struct EventLogRecord
+{
+    // Published with EventBus::PublishThreadSafe(), so never coalesced.
+    static const uint32 FLAG_THREAD_SAFE = 1 << 0;
+    // Dropped by a full thread-safe queue rather than dispatched.
+    static const uint32 FLAG_SHED        = 1 << 1;
+
+    uint32    frame; // EventBus::Update() it was dispatched in, from 0.
+    UUID      type;
+    TimeStamp time;  // App::Time() since recording started.
+    uint32    size;  // Payload bytes.
+    uint32    flags;
+};
+
+// Appends records to a log; writes are buffered by stdio.
+class EventRecorder
+{
+public:
+    ~EventRecorder() { Close(); }
+
+    bool Open(const std::string& file);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    // Returns false on failure, after which the recorder is closed.
+    bool Write(const EventLogRecord& r, const void* payload);
+
+private:
+    std::FILE*  m_file = nullptr;
+    std::string m_path;
+};
+
+// Memory-maps a log and walks its records without copying them.
+class EventReplayer
+{
+public:
+    ~EventReplayer() { Close(); }
+
+    bool Open(const std::string& file);
+    void Close();
+    bool IsOpen() const { return m_data != nullptr; }
+
+    // Returns false at the end of the log; payload points into the mapping.
+    bool Peek(EventLogRecord& r, const void*& payload) const;
+    void Advance();
+    void Rewind() { m_cursor = sizeof(EventLogHeader); }
+
+private:
+    const uint8* m_data   = nullptr;
+    uint64       m_size   = 0;
+    uint64       m_cursor = 0;
+    void*        m_mapping = nullptr; // OS handle, if any.
+
+    static uint64 PaddedSize_(uint32 size) { return ((uint64)size + 7) & ~(uint64)7; }
+};
+
+#endif // EVENT_RECORDER_HPP
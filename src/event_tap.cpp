@@ -0,0 +1,273 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "event_tap.hpp"
+
+#include <cstring> // memcpy/strlen
+
+#if defined(OS_WINDOWS)
+
+    // @todo CreateFileMapping() with a named, pagefile-backed section.
+
+    bool EventTap::Open(const std::string& /*name*/, uint64 /*capacity*/, uint64 /*timePerSecond*/)
+    {
+        LogWarning("The event tap isn't supported on Windows.");
+        return false;
+    }
+
+    void EventTap::Close() {}
+    void EventTap::Write(UUID /*type*/, const char* /*name*/, uint32 /*frame*/, TimeStamp /*time*/, const void* /*payload*/, uint32 /*payloadSize*/) {}
+
+    bool EventTapReader::Open(const std::string& /*name*/)
+    {
+        LogWarning("The event tap isn't supported on Windows.");
+        return false;
+    }
+
+    void EventTapReader::Close() {}
+    bool EventTapReader::Read(Event& /*e*/, uint64& lost) { lost = 0; return false; }
+
+#elif defined(OS_LINUX)
+
+    #include <fcntl.h> // O_*
+    #include <new> // placement new
+    #include <sys/mman.h> // mmap/munmap/shm_open/shm_unlink
+    #include <sys/stat.h> // fstat
+    #include <unistd.h> // close/ftruncate
+
+    static uint64 TapPadded_(uint64 size) { return (size + 7) & ~(uint64)7; }
+
+    bool EventTap::Open(const std::string& name, uint64 capacity, uint64 timePerSecond)
+    {
+        Close();
+
+        uint64 c = 4096;
+        while (c < capacity)
+            c <<= 1;
+
+        // Replaces a ring left behind by a crashed run.
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1)
+        {
+            LogWarning("Failed to create shared memory: %s.", name.c_str());
+            return false;
+        }
+
+        uint64 size = sizeof(EventTapHeader) + c;
+        if (ftruncate(fd, size) == -1)
+        {
+            LogWarning("Failed to size shared memory: %s.", name.c_str());
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            LogWarning("Failed to map shared memory: %s.", name.c_str());
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        m_header = new (p) EventTapHeader;
+        m_header->capacity      = c;
+        m_header->timePerSecond = timePerSecond;
+        m_header->reserveCursor.store(0, std::memory_order_relaxed);
+        m_header->writeCursor.store(0, std::memory_order_relaxed);
+        m_header->version       = EventTapHeader::VERSION;
+        // Last, so readers never see a half-initialized header.
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic         = EventTapHeader::MAGIC;
+
+        m_data       = (uint8*)p + sizeof(EventTapHeader);
+        m_mask       = c - 1;
+        m_cursor     = 0;
+        m_mappedSize = size;
+        m_name       = name;
+
+        LogInfo("Tapping events to shared memory %s.", m_name.c_str());
+        return true;
+    }
+
+    void EventTap::Close()
+    {
+        if (m_header)
+        {
+            munmap(m_header, m_mappedSize);
+            shm_unlink(m_name.c_str());
+            m_header = nullptr;
+            m_data   = nullptr;
+        }
+    }
+
+    void EventTap::Write(UUID type, const char* name, uint32 frame, TimeStamp time, const void* payload, uint32 payloadSize)
+    {
+        uint64 nameLength = std::strlen(name);
+        if (nameLength > EventTapReader::MAX_NAME)
+            nameLength = EventTapReader::MAX_NAME;
+        if (payloadSize > EventTapReader::MAX_PAYLOAD)
+            payloadSize = EventTapReader::MAX_PAYLOAD;
+
+        uint64 size = TapPadded_(sizeof(EventTapRecord) + nameLength + payloadSize);
+        if (size > m_header->capacity / 4)
+            return; // Would lap every reader by itself.
+
+        EventTapRecord r;
+        r.size        = size;
+        r.type        = type;
+        r.frame       = frame;
+        r.payloadSize = payloadSize;
+        r.nameLength  = nameLength;
+        r.reserved    = 0;
+        r.time        = time;
+
+        m_header->reserveCursor.store(m_cursor + size, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        // Records start 8-byte aligned and capacity is a multiple of 8, so
+        // the header never wraps; the rest might.
+        uint64 at = m_cursor & m_mask;
+        std::memcpy(m_data + at, &r, sizeof(r));
+        const void* parts[2]     = {name, payload};
+        uint64      partSizes[2] = {nameLength, payloadSize};
+        uint64      offset = m_cursor + sizeof(r);
+        for (uint32 i = 0; i < 2; i++)
+        {
+            at = offset & m_mask;
+            uint64 first = m_header->capacity - at;
+            if (first > partSizes[i])
+                first = partSizes[i];
+            std::memcpy(m_data + at, parts[i], first);
+            std::memcpy(m_data, (const uint8*)parts[i] + first, partSizes[i] - first);
+            offset += partSizes[i];
+        }
+
+        m_cursor += size;
+        m_header->writeCursor.store(m_cursor, std::memory_order_release);
+    }
+
+    bool EventTapReader::Open(const std::string& name)
+    {
+        Close();
+
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd == -1)
+        {
+            LogWarning("Failed to open shared memory: %s.", name.c_str());
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(EventTapHeader))
+        {
+            LogWarning("Shared memory is too small: %s.", name.c_str());
+            close(fd);
+            return false;
+        }
+
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            LogWarning("Failed to map shared memory: %s.", name.c_str());
+            return false;
+        }
+
+        const EventTapHeader* h = (const EventTapHeader*)p;
+        if (h->magic != EventTapHeader::MAGIC || h->version != EventTapHeader::VERSION ||
+            (uint64)st.st_size < sizeof(EventTapHeader) + h->capacity)
+        {
+            LogWarning("Not a supported event tap: %s.", name.c_str());
+            munmap(p, st.st_size);
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        m_header     = h;
+        m_data       = (const uint8*)p + sizeof(EventTapHeader);
+        m_mask       = h->capacity - 1;
+        m_cursor     = h->writeCursor.load(std::memory_order_acquire);
+        m_mappedSize = st.st_size;
+        return true;
+    }
+
+    void EventTapReader::Close()
+    {
+        if (m_header)
+        {
+            munmap((void*)m_header, m_mappedSize);
+            m_header = nullptr;
+            m_data   = nullptr;
+        }
+    }
+
+    bool EventTapReader::Read(Event& e, uint64& lost)
+    {
+        lost = 0;
+        while (true)
+        {
+            uint64 written = m_header->writeCursor.load(std::memory_order_acquire);
+            if (written == m_cursor)
+                return false;
+            if (written - m_cursor > m_header->capacity)
+            {
+                lost  += written - m_cursor;
+                m_cursor = written;
+                continue;
+            }
+
+            EventTapRecord r;
+            Copy_(m_cursor, &r, sizeof(r));
+            bool sane = (r.size >= sizeof(r) && r.size <= m_header->capacity / 4 &&
+                         r.nameLength <= MAX_NAME && r.payloadSize <= MAX_PAYLOAD &&
+                         sizeof(r) + r.nameLength + r.payloadSize <= r.size);
+            if (sane)
+            {
+                Copy_(m_cursor + sizeof(r), e.name, r.nameLength);
+                Copy_(m_cursor + sizeof(r) + r.nameLength, e.payload, r.payloadSize);
+            }
+
+            // If the writer has reserved past this record's bytes, it may have
+            // overwritten them while they were copied.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64 reserved = m_header->reserveCursor.load(std::memory_order_relaxed);
+            if (!sane || reserved - m_cursor > m_header->capacity)
+            {
+                written = m_header->writeCursor.load(std::memory_order_acquire);
+                lost  += written - m_cursor;
+                m_cursor = written;
+                continue;
+            }
+
+            e.type        = r.type;
+            e.frame       = r.frame;
+            e.time        = r.time;
+            e.name[r.nameLength] = '\0';
+            e.payloadSize = r.payloadSize;
+            m_cursor += r.size;
+            return true;
+        }
+    }
+
+    void EventTapReader::Copy_(uint64 position, void* to, uint64 size) const
+    {
+        uint64 at    = position & m_mask;
+        uint64 first = m_header->capacity - at;
+        if (first > size)
+            first = size;
+        std::memcpy(to, m_data + at, first);
+        std::memcpy((uint8*)to + first, m_data, size - first);
+    }
+
+#else
+
+    #error Unknown OS.
+
+#endif // OS_WINDOWS.
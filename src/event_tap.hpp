@@ -0,0 +1,120 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef EVENT_TAP_HPP
+#define EVENT_TAP_HPP
+
+// Live event stream in a POSIX shared memory ring, written by
+// EventBus::StartTap() and read by other processes, e.g., ellie-tap.
+//
+// The ring is a seqlock: the writer bumps reserveCursor, writes, then bumps
+// writeCursor, and never waits. Readers copy a record out, then check
+// reserveCursor to see whether the writer lapped them mid-copy; if it did,
+// they skip ahead and report the loss.
+//
+// Layout: EventTapHeader, then capacity bytes of records. Each record is an
+// EventTapRecord, the event's name, and its payload, padded to 8 bytes.
+
+#include "global.hpp"
+
+#include <atomic>
+#include <string>
+
+struct EventTapHeader
+{
+    static const uint32 MAGIC   = 0x50415445; // "ETAP"
+    static const uint32 VERSION = 1;
+
+    uint32 magic;
+    uint32 version;
+    uint64 capacity;      // Power of two.
+    uint64 timePerSecond; // App::TimePerSecond() of the writer.
+
+    // Bytes ever written; records start at multiples of 8.
+    alignas(64) std::atomic<uint64> reserveCursor;
+    alignas(64) std::atomic<uint64> writeCursor;
+};
+
+static_assert(std::atomic<uint64>::is_always_lock_free, "The event tap needs lock-free 64-bit atomics.");
+
+struct EventTapRecord
+{
+    uint32    size; // Including this header and padding.
+    UUID      type;
+    uint32    frame;
+    uint16    payloadSize;
+    uint8     nameLength;
+    uint8     reserved;
+    TimeStamp time;
+};
+
+// Writer side; owns the shared memory and unlinks it on Close().
+class EventTap
+{
+public:
+    static constexpr const char* DEFAULT_NAME = "/ellie-events";
+
+    ~EventTap() { Close(); }
+
+    bool Open(const std::string& name, uint64 capacity, uint64 timePerSecond);
+    void Close();
+    bool IsOpen() const { return m_header != nullptr; }
+
+    // Never blocks; readers that fall behind lose events instead.
+    void Write(UUID type, const char* name, uint32 frame, TimeStamp time, const void* payload, uint32 payloadSize);
+
+private:
+    EventTapHeader* m_header = nullptr;
+    uint8*          m_data   = nullptr;
+    uint64          m_mask   = 0;
+    uint64          m_cursor = 0;
+    uint64          m_mappedSize = 0;
+    std::string     m_name;
+};
+
+// Reader side.
+class EventTapReader
+{
+public:
+    // Longest name and payload Read() hands back.
+    static const uint32 MAX_NAME    = 255;
+    static const uint32 MAX_PAYLOAD = 0xFFFF;
+
+    struct Event
+    {
+        UUID        type;
+        uint32      frame;
+        TimeStamp   time;
+        char        name[MAX_NAME + 1];
+        uint32      payloadSize;
+        uint8       payload[MAX_PAYLOAD];
+    };
+
+    ~EventTapReader() { Close(); }
+
+    // Starts at the newest event.
+    bool Open(const std::string& name);
+    void Close();
+    bool IsOpen() const { return m_header != nullptr; }
+
+    uint64 TimePerSecond() const { return m_header->timePerSecond; }
+
+    // Returns false when there's nothing new. lost is set to the number of
+    // bytes skipped because the writer lapped this reader.
+    bool Read(Event& e, uint64& lost);
+
+private:
+    const EventTapHeader* m_header = nullptr;
+    const uint8*          m_data   = nullptr;
+    uint64                m_mask   = 0;
+    uint64                m_cursor = 0;
+    uint64                m_mappedSize = 0;
+
+    void Copy_(uint64 position, void* to, uint64 size) const;
+};
+
+#endif // EVENT_TAP_HPP
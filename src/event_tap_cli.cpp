@@ -0,0 +1,102 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+// ellie-tap: streams the events of a running ellie from its event tap.
+//
+//     ellie-tap [-n shm_name] [-f name_filter] [-x]
+//
+// -f only prints events whose name contains name_filter; -x dumps payloads
+// in hex. Runs until interrupted.
+
+#include "global.hpp"
+#include "event_tap.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring> // strcmp/strstr
+#include <memory>
+#include <string>
+#include <thread>
+
+static volatile std::sig_atomic_t quit_ = 0;
+
+static void OnSignal_(int /*signal*/)
+{
+    quit_ = 1;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name   = EventTap::DEFAULT_NAME;
+    const char* filter = nullptr;
+    bool        hex    = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            name = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-x") == 0)
+        {
+            hex = true;
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [-n shm_name] [-f name_filter] [-x]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    EventTapReader reader;
+    if (!reader.Open(name))
+        return 1;
+
+    std::signal(SIGINT, OnSignal_);
+    std::signal(SIGTERM, OnSignal_);
+
+    // Too big for the stack.
+    std::unique_ptr<EventTapReader::Event> e(new EventTapReader::Event);
+    float64   msPerTick = 1000.0 / (float64)reader.TimePerSecond();
+    TimeStamp firstTime = 0;
+    uint64    lost      = 0;
+    while (!quit_)
+    {
+        if (!reader.Read(*e, lost))
+        {
+            if (lost)
+                std::printf("-- lost %llu bytes of events\n", (unsigned long long)lost);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (lost)
+            std::printf("-- lost %llu bytes of events\n", (unsigned long long)lost);
+
+        if (filter && !std::strstr(e->name, filter))
+            continue;
+
+        if (!firstTime)
+            firstTime = e->time;
+
+        std::printf("%10u %12.3f %-24s %08X %5u", e->frame, (float64)(e->time - firstTime) * msPerTick,
+                    e->name, (unsigned)e->type, e->payloadSize);
+        if (hex)
+        {
+            std::printf(" ");
+            for (uint32 i = 0; i < e->payloadSize; i++)
+                std::printf("%02X", e->payload[i]);
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+    return 0;
+}
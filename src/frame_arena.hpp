@@ -0,0 +1,126 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include "global.hpp"
+
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <memory> // unique_ptr
+#include <new> // nothrow/placement new
+#include <type_traits> // is_trivially_destructible
+#include <utility> // forward
+#include <vector>
+
+// Bump allocator for objects that all die together, e.g., everything
+// published to the EventBus during a frame. Allocation is a pointer bump;
+// Reset() runs the destructors and rewinds, but keeps the memory for reuse.
+class FrameArena
+{
+public:
+    explicit FrameArena(std::size_t blockSize = KIBIBYTES(64)) : m_blockSize(blockSize) {}
+    ~FrameArena() { Reset(); }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Returns nullptr on allocation failure.
+    template<class T, class... Args>
+    T* New(Args&&... args)
+    {
+        void* p = Allocate(sizeof(T), alignof(T));
+        if (!p)
+            return nullptr;
+
+        T* t = new (p) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible<T>::value)
+            m_destructors.push_back(Destructor_{t, [](void* o) { static_cast<T*>(o)->~T(); }});
+        return t;
+    }
+
+    // Returns nullptr on allocation failure.
+    void* Allocate(std::size_t size, std::size_t alignment)
+    {
+        while (m_block < m_blocks.size())
+        {
+            void* p = AllocateFrom_(m_blocks[m_block], size, alignment);
+            if (p)
+                return p;
+
+            m_block++;
+            m_offset = 0;
+        }
+
+        std::size_t blockSize = m_blockSize;
+        if (size + alignment > blockSize)
+            blockSize = size + alignment;
+
+        Block_ b;
+        b.data.reset(new (std::nothrow) uint8[blockSize]);
+        if (!b.data)
+            return nullptr;
+        b.size = blockSize;
+        m_blocks.push_back(std::move(b));
+        m_block  = m_blocks.size() - 1;
+        m_offset = 0;
+
+        return AllocateFrom_(m_blocks[m_block], size, alignment);
+    }
+
+    void Reset()
+    {
+        for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); it++)
+            it->destroy(it->object);
+        m_destructors.clear();
+
+        m_block  = 0;
+        m_offset = 0;
+    }
+
+    std::size_t BytesReserved() const
+    {
+        std::size_t r = 0;
+        for (const Block_& b : m_blocks)
+            r += b.size;
+        return r;
+    }
+
+private:
+    struct Block_
+    {
+        std::unique_ptr<uint8[]> data;
+        std::size_t size = 0;
+    };
+
+    struct Destructor_
+    {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::size_t m_blockSize;
+    std::vector<Block_> m_blocks;
+    std::size_t m_block  = 0; // Block currently being allocated from.
+    std::size_t m_offset = 0; // Offset of the first free byte in m_block.
+    std::vector<Destructor_> m_destructors;
+
+    void* AllocateFrom_(Block_& b, std::size_t size, std::size_t alignment)
+    {
+        std::uintptr_t base    = (std::uintptr_t)b.data.get();
+        std::uintptr_t aligned = (base + m_offset + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+        std::size_t    end     = (aligned - base) + size;
+        if (end > b.size)
+            return nullptr;
+
+        m_offset = end;
+        return (void*)aligned;
+    }
+};
+
+#endif // FRAME_ARENA_HPP
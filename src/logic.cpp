@@ -19,25 +19,40 @@ bool Logic::Init()
 
     UpdateCameraVectors();
 
-    m_subscriberMoveCamera   = m_app->Events()->Subscribe(EVENTBUS_SUB_THIS_MEMBER(Logic::OnMoveCamera,   EventMoveCamera));
-    m_subscriberRotateCamera = m_app->Events()->Subscribe(EVENTBUS_SUB_THIS_MEMBER(Logic::OnRotateCamera, EventRotateCamera));
-    m_subscriberZoomCamera   = m_app->Events()->Subscribe(EVENTBUS_SUB_THIS_MEMBER(Logic::OnZoomCamera,   EventZoomCamera));
+    m_systems.SetThreadPool(m_app->Workers());
+    m_processes.SetThreadPool(m_app->Workers());
+    m_processes.SetMetricsEnabled(m_app->m_options.processes.metrics, m_app->m_options.processes.metricsTopCount);
+
+    m_subscriberMoveCamera   = m_app->Events()->Subscribe<EventMoveCamera,   &Logic::OnMoveCamera>  (this);
+    m_subscriberRotateCamera = m_app->Events()->Subscribe<EventRotateCamera, &Logic::OnRotateCamera>(this);
+    m_subscriberZoomCamera   = m_app->Events()->Subscribe<EventZoomCamera,   &Logic::OnZoomCamera>  (this);
+
+    // Camera input can arrive many times per frame; only the net change matters.
+    m_app->Events()->SetCoalescer<EventMoveCamera>(EventBus::CoalesceKeepLatest<EventMoveCamera>);
+    m_app->Events()->SetCoalescer<EventRotateCamera>([](EventRotateCamera& queued, const EventRotateCamera& incoming)
+    {
+        queued.xrel += incoming.xrel;
+        queued.yrel += incoming.yrel;
+    });
 
     return true;
 }
 
 void Logic::Cleanup()
 {
-    m_subscriberZoomCamera.reset();
-    m_subscriberRotateCamera.reset();
-    m_subscriberMoveCamera.reset();
+    m_subscriberZoomCamera.Reset();
+    m_subscriberRotateCamera.Reset();
+    m_subscriberMoveCamera.Reset();
 
     m_processes.AbortAll(true);
 }
 
 bool Logic::Update(DeltaTime dt)
 {
-    m_processes.Update(dt);
+    m_systems.Run(m_entities, dt);
+
+    DeltaTime budget = m_app->m_options.processes.logicBudget;
+    m_processes.Update(dt, budget > 0.0f, budget);
     return !m_quit;
 }
 
@@ -52,28 +67,26 @@ void Logic::UpdateCameraVectors()
     m_app->m_options.camera.up    = glm::normalize(glm::cross(m_app->m_options.camera.right, m_app->m_options.camera.front));
 }
 
-void Logic::OnMoveCamera(EventStrongPtr e)
+void Logic::OnMoveCamera(const EventMoveCamera& e)
 {
-    EventMoveCamera* d = dynamic_cast<EventMoveCamera*>(e.get());
-    if (d->forward)
-        m_app->m_options.camera.position += m_app->m_options.camera.front * m_app->m_options.camera.speed * d->dt;
-    else if (d->backward)
-        m_app->m_options.camera.position -= m_app->m_options.camera.front * m_app->m_options.camera.speed * d->dt;
-    if (d->left)
-        m_app->m_options.camera.position -= m_app->m_options.camera.right * m_app->m_options.camera.speed * d->dt;
-    else if (d->right)
-        m_app->m_options.camera.position += m_app->m_options.camera.right * m_app->m_options.camera.speed * d->dt;
+    if (e.forward)
+        m_app->m_options.camera.position += m_app->m_options.camera.front * m_app->m_options.camera.speed * e.dt;
+    else if (e.backward)
+        m_app->m_options.camera.position -= m_app->m_options.camera.front * m_app->m_options.camera.speed * e.dt;
+    if (e.left)
+        m_app->m_options.camera.position -= m_app->m_options.camera.right * m_app->m_options.camera.speed * e.dt;
+    else if (e.right)
+        m_app->m_options.camera.position += m_app->m_options.camera.right * m_app->m_options.camera.speed * e.dt;
 
     // @todo This keeps the camera grounded FPS style, but it also makes
     //       forward/backward movement slow when at an extreme pitch. Why?
     //m_cameraPosition.y = 0.0f;
 }
 
-void Logic::OnRotateCamera(EventStrongPtr e)
+void Logic::OnRotateCamera(const EventRotateCamera& e)
 {
-    EventRotateCamera* d = dynamic_cast<EventRotateCamera*>(e.get());
-    m_app->m_options.camera.yaw   += (m_app->m_options.camera.yawInverted   ? -d->xrel : d->xrel) * m_app->m_options.camera.yawSensitivity;
-    m_app->m_options.camera.pitch -= (m_app->m_options.camera.pitchInverted ? -d->yrel : d->yrel) * m_app->m_options.camera.pitchSensitivity;
+    m_app->m_options.camera.yaw   += (m_app->m_options.camera.yawInverted   ? -e.xrel : e.xrel) * m_app->m_options.camera.yawSensitivity;
+    m_app->m_options.camera.pitch -= (m_app->m_options.camera.pitchInverted ? -e.yrel : e.yrel) * m_app->m_options.camera.pitchSensitivity;
 
     if (m_app->m_options.camera.yaw > 360.0f)
         m_app->m_options.camera.yaw -= 360.0f;
@@ -88,10 +101,9 @@ void Logic::OnRotateCamera(EventStrongPtr e)
     UpdateCameraVectors();
 }
 
-void Logic::OnZoomCamera(EventStrongPtr e)
+void Logic::OnZoomCamera(const EventZoomCamera& e)
 {
-    EventZoomCamera* d = dynamic_cast<EventZoomCamera*>(e.get());
-    if (d->in)
+    if (e.in)
         m_app->m_options.camera.fov -= m_app->m_options.camera.fovStep;
     else
         m_app->m_options.camera.fov += m_app->m_options.camera.fovStep;
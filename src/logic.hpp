@@ -9,37 +9,47 @@
 #define LOGIC_HPP
 
 #include "global.hpp"
+#include "entity_manager.hpp"
 #include "event_bus.hpp"
 #include "process_manager.hpp"
+#include "system_scheduler.hpp"
 
 class App;
+class EventMoveCamera;
+class EventRotateCamera;
+class EventZoomCamera;
 
 class Logic
 {
 public:
     // @todo Time Dilation:
     //       modify dt to speed/slow time; may require adjusting App/View dt.
-    // @todo Entity Component System.
 
     bool Init();
     void Cleanup();
     bool Update(DeltaTime dt);
 
+    EntityManager&   Entities()  { return m_entities; }
+    ProcessManager&  Processes() { return m_processes; }
+    SystemScheduler& Systems()   { return m_systems; }
+
 private:
     App* m_app  = nullptr;
     bool m_quit = false;
-    ProcessManager m_processes;
+    EntityManager   m_entities;
+    SystemScheduler m_systems;
+    ProcessManager  m_processes;
 
-    EventBus::SubscriberIDStrongPtr m_subscriberMoveCamera;
-    EventBus::SubscriberIDStrongPtr m_subscriberRotateCamera;
-    EventBus::SubscriberIDStrongPtr m_subscriberZoomCamera;
+    EventBus::Subscription m_subscriberMoveCamera;
+    EventBus::Subscription m_subscriberRotateCamera;
+    EventBus::Subscription m_subscriberZoomCamera;
 
     // @todo Replace with an ECS camera entity when possible.
     void UpdateCameraVectors();
 
-    void OnMoveCamera  (EventStrongPtr e);
-    void OnRotateCamera(EventStrongPtr e);
-    void OnZoomCamera  (EventStrongPtr e);
+    void OnMoveCamera  (const EventMoveCamera&   e);
+    void OnRotateCamera(const EventRotateCamera& e);
+    void OnZoomCamera  (const EventZoomCamera&   e);
 };
 
 #endif // LOGIC_HPP
@@ -0,0 +1,100 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+// Dmitry Vyukov's intrusive multi-producer/single-consumer queue:
+// http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+// Push() is wait-free (a single atomic exchange) and can be called from any
+// thread; Pop() must only be called from one thread at a time.
+
+#include "global.hpp"
+
+#include <atomic>
+#include <new> // nothrow
+#include <utility> // move
+
+template<class T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() : m_head(&m_stub), m_tail(&m_stub) { m_stub.next.store(nullptr, std::memory_order_relaxed); }
+    ~MPSCQueue()
+    {
+        T v;
+        while (Pop(v))
+            ;
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Returns false if memory couldn't be allocated.
+    bool Push(T v)
+    {
+        Node_* n = new (std::nothrow) Node_;
+        if (!n)
+            return false;
+        n->value = std::move(v);
+        Push_(n);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty, or if the only
+    // remaining items are still being pushed; those show up on a later Pop().
+    bool Pop(T& v)
+    {
+        Node_* tail = m_tail;
+        Node_* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub)
+        {
+            if (!next)
+                return false;
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (!next)
+        {
+            if (tail != m_head.load(std::memory_order_acquire))
+                return false;
+
+            Push_(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+        }
+
+        m_tail = next;
+        v = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node_
+    {
+        std::atomic<Node_*> next;
+        T value;
+    };
+
+    // Producers only touch m_head; keep it off the consumer's cache line.
+    alignas(64) std::atomic<Node_*> m_head;
+    alignas(64) Node_* m_tail;
+    Node_ m_stub;
+
+    void Push_(Node_* n)
+    {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        Node_* prev = m_head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+};
+
+#endif // MPSC_QUEUE_HPP
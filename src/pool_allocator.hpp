@@ -0,0 +1,188 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef POOL_ALLOCATOR_HPP
+#define POOL_ALLOCATOR_HPP
+
+#include "global.hpp"
+
+#include <cstddef> // max_align_t/size_t
+#include <memory> // unique_ptr
+#include <new> // bad_alloc/nothrow
+#include <vector>
+
+// Fixed-size blocks carved out of large chunks and recycled through an
+// intrusive free list; Allocate() and Free() are a couple of loads and
+// stores. Chunks are only released when the pool is destroyed.
+// @warning Not thread-safe.
+class FixedPool
+{
+public:
+    FixedPool(size_t blockSize, size_t blockAlign, uint32 blocksPerChunk = 64)
+    {
+        if (blockSize < sizeof(FreeBlock_))
+            blockSize = sizeof(FreeBlock_);
+        if (blockAlign < alignof(FreeBlock_))
+            blockAlign = alignof(FreeBlock_);
+
+        m_blockAlign     = blockAlign;
+        m_blockSize      = (blockSize + blockAlign - 1) & ~(blockAlign - 1);
+        m_blocksPerChunk = blocksPerChunk;
+    }
+
+    ~FixedPool()
+    {
+        for (void* c : m_chunks)
+            ::operator delete(c, std::align_val_t(m_blockAlign));
+    }
+
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+    // Returns nullptr on failure.
+    void* Allocate()
+    {
+        if (!m_free && !Grow_())
+            return nullptr;
+
+        FreeBlock_* b = m_free;
+        m_free = b->next;
+        m_used++;
+        return b;
+    }
+
+    void Free(void* p)
+    {
+        FreeBlock_* b = static_cast<FreeBlock_*>(p);
+        b->next = m_free;
+        m_free  = b;
+        m_used--;
+    }
+
+    size_t BlockSize()     const { return m_blockSize; }
+    uint32 BlocksUsed()    const { return m_used; }
+    size_t BytesReserved() const { return m_chunks.size() * m_blockSize * m_blocksPerChunk; }
+
+private:
+    struct FreeBlock_
+    {
+        FreeBlock_* next;
+    };
+
+    size_t m_blockSize;
+    size_t m_blockAlign;
+    uint32 m_blocksPerChunk;
+    uint32 m_used = 0;
+
+    FreeBlock_*        m_free = nullptr;
+    std::vector<void*> m_chunks;
+
+    bool Grow_()
+    {
+        uint8* c = static_cast<uint8*>(::operator new(m_blockSize * m_blocksPerChunk, std::align_val_t(m_blockAlign), std::nothrow));
+        if (!c)
+            return false;
+        m_chunks.push_back(c);
+
+        // Threaded back to front, so blocks are handed out in address order.
+        for (uint32 i = m_blocksPerChunk; i-- > 0;)
+        {
+            FreeBlock_* b = reinterpret_cast<FreeBlock_*>(c + i * m_blockSize);
+            b->next = m_free;
+            m_free  = b;
+        }
+        return true;
+    }
+};
+
+// Standard allocator over one FixedPool per type, so objects of a type are
+// packed together, e.g., std::allocate_shared<T>(PoolAllocator<T>()) puts T
+// and its control block in a single pooled block. Arrays fall back to the
+// heap.
+// @warning Not thread-safe.
+template<class T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    PoolAllocator() {}
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        void* p = (n == 1 ? Pool().Allocate() : ::operator new(n * sizeof(T), std::align_val_t(alignof(T)), std::nothrow));
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1)
+            Pool().Free(p);
+        else
+            ::operator delete(p, std::align_val_t(alignof(T)));
+    }
+
+    static FixedPool& Pool()
+    {
+        static FixedPool pool(sizeof(T), alignof(T));
+        return pool;
+    }
+};
+
+template<class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+template<class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+// FixedPools for blocks of up to MAX_SIZE bytes in STEP-byte size classes,
+// for allocations whose size is only known at run time, e.g., coroutine
+// frames. Bigger blocks fall back to the heap.
+// @warning Not thread-safe.
+class SizeClassPool
+{
+public:
+    static const size_t STEP     = 64;
+    static const size_t MAX_SIZE = 2048;
+
+    // Returns nullptr on failure.
+    void* Allocate(size_t size)
+    {
+        if (size > MAX_SIZE)
+            return ::operator new(size, std::nothrow);
+
+        std::unique_ptr<FixedPool>& pool = m_classes[Class_(size)];
+        if (!pool)
+        {
+            pool.reset(new (std::nothrow) FixedPool((Class_(size) + 1) * STEP, alignof(std::max_align_t)));
+            if (!pool)
+                return nullptr;
+        }
+        return pool->Allocate();
+    }
+
+    // size must be what was passed to Allocate().
+    void Free(void* p, size_t size)
+    {
+        if (size > MAX_SIZE)
+            ::operator delete(p);
+        else
+            m_classes[Class_(size)]->Free(p);
+    }
+
+private:
+    static const uint32 NUM_CLASSES = MAX_SIZE / STEP;
+
+    std::unique_ptr<FixedPool> m_classes[NUM_CLASSES];
+
+    static uint32 Class_(size_t size) { return (size ? (size - 1) / STEP : 0); }
+};
+
+#endif // POOL_ALLOCATOR_HPP
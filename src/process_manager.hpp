@@ -11,11 +11,57 @@
 // Cooperative Multitasking from Game Coding Complete, Fourth Edition.
 
 #include "global.hpp"
-
-#include <list>
+#include "app.hpp"
+#include "event_bus.hpp"
+#include "pool_allocator.hpp"
+#include "process_metrics.hpp"
+#include "thread_pool.hpp"
+#include "timer_wheel.hpp"
+
+#include <cstdlib> // free
+#include <cstring> // strncpy
 #include <memory> // shared_ptr/weak_ptr.
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility> // forward/move
+#include <vector>
+
+#if defined(COMPILER_CLANG) || defined(COMPILER_GCC) || defined(COMPILER_MINGW)
+    #include <cxxabi.h> // __cxa_demangle
+#endif
+
+// ProcessManager::Update() updates each class in order; only Critical
+// processes are guaranteed to be updated every frame.
+enum class ProcessPriority : uint32
+{
+    Critical,   // Never skipped, e.g., input or camera.
+    Normal,
+    Background, // Gets whatever time Normal leaves.
+    Count
+};
+
+// Where a process' OnUpdate() may be called; everything else, i.e., OnInit(),
+// the other callbacks and settling its state, stays on the thread calling
+// ProcessManager::Update().
+// @warning Concurrent processes' OnUpdate() must be thread-safe: it can run on
+//          any worker, concurrently with other processes and the main thread.
+//          It mustn't touch its ProcessManager, other processes or the
+//          EventBus other than PublishThreadSafe(); changing its own state,
+//          e.g., Succeed() or SleepFor(), is fine.
+enum class ProcessDispatch
+{
+    MainThread,
+    // Run on the ProcessManager's thread pool, if it has one, and waited for
+    // before Update() returns.
+    Concurrent
+};
+
+class ProcessManager;
 
-class Process
+class Process : public std::enable_shared_from_this<Process>
 {
 protected:
     virtual void OnInit()    { m_state = State::Running; }
@@ -38,6 +84,7 @@ public:
         // Alive
         Running,
         Paused,
+        Sleeping,
         // Dead
         Succeeded,
         Failed, // may not have initialized successfully.
@@ -58,16 +105,63 @@ public:
     }
 
     State State()    const { return m_state; }
-    bool IsAlive()   const { return (m_state == State::Running || m_state == State::Paused); }
+    bool IsAlive()   const { return (m_state == State::Running || m_state == State::Paused || m_state == State::Sleeping); }
     bool IsDead()    const { return (m_state == State::Succeeded || m_state == State::Failed || m_state == State::Aborted); }
     bool IsRemoved() const { return m_state == State::Removed; }
     bool IsPaused()  const { return m_state == State::Paused; }
+    bool IsSleeping() const { return m_state == State::Sleeping; }
 
     void Succeed() { m_state = State::Succeeded; }
     void Fail()    { m_state = State::Failed; }
     void Pause()   { if (m_state == State::Running) m_state = State::Paused; }
     void Unpause() { if (m_state == State::Paused)  m_state = State::Running; }
 
+    // Stops OnUpdate() until time, an App::Time(), or until an event of type
+    // is published; when both are asked for, whichever comes first. Sleeping
+    // processes are kept off ProcessManager's update list, so they cost
+    // nothing per frame; see also ProcessManager::Wake().
+    // Returns false, and doesn't sleep, unless the process is running or
+    // already sleeping.
+    // @warning Only a running process can go to sleep, e.g., from OnUpdate().
+    bool SleepUntil(TimeStamp time)
+    {
+        if (!Sleep_())
+            return false;
+        m_wakeOnTime = true;
+        m_wakeTime   = time;
+        return true;
+    }
+
+    bool SleepFor(DeltaTime milliseconds)
+    {
+        return SleepUntil(App::Time() + (TimeStamp)(milliseconds * (DeltaTime)App::TimePerSecond() / 1000.0f));
+    }
+
+    bool SleepUntilEvent(UUID type)
+    {
+        if (!Sleep_())
+            return false;
+        m_wakeOnEvent = true;
+        m_wakeEvent   = type;
+        return true;
+    }
+
+    template<class EventT>
+    bool SleepUntilEvent() { return SleepUntilEvent(EventT::TYPE); }
+
+    // Until p is dead, which p's ProcessManager notices and passes on to
+    // this one's, if that's another; also false if p is already dead.
+    // This must already be owned by a StrongPtr.
+    // @warning Both ProcessManagers must be updated on the same thread.
+    bool SleepUntilProcess(StrongPtr p)
+    {
+        if (p->IsDead() || !Sleep_())
+            return false;
+        m_wakeProcess = p.get();
+        p->m_deathWaiters.push_back(WeakPtr(shared_from_this()));
+        return true;
+    }
+
     void AttachChild(StrongPtr c)
     {
         if (m_child)
@@ -93,106 +187,746 @@ public:
     bool HasChild() const { return m_child != nullptr; }
     StrongPtr PeekChild() { return m_child; }
 
+    // For metrics reports; the class' name unless overridden.
+    virtual const char* Name() const { return TypeName_(typeid(*this)); }
+
+    // nullptr unless the process' ProcessManager has metrics enabled.
+    const ProcessMetrics* Metrics() const { return m_metrics.get(); }
+
+    // d waits until this and the rest of its prerequisites have succeeded,
+    // then ProcessManager attaches it; if any of them fails or is aborted, d
+    // and its dependents are aborted without running. Unlike a child chain,
+    // a process can have any number of both, so, e.g., a loading pipeline
+    // can be one graph whose ready branches all start in the same frame, and
+    // in parallel if they're ProcessDispatch::Concurrent.
+    // If this has already succeeded, d doesn't wait for it; if it's already
+    // failed or been aborted, d and its dependents are aborted now.
+    // Returns false, adding nothing, if d has already been attached.
+    // @warning Don't make cycles; they never run.
+    bool AddDependent(StrongPtr d)
+    {
+        SDL_assert(!d->m_attached && d->m_state == State::Uninitialized);
+        if (d->m_attached || d->m_state != State::Uninitialized)
+            return false;
+
+        if (m_state == State::Succeeded)
+            return true;
+        if (m_state == State::Failed || m_state == State::Aborted)
+        {
+            d->AbortUnstarted_();
+            return true;
+        }
+
+        d->m_pendingPrerequisites++;
+        m_dependents.push_back(d);
+        return true;
+    }
+
+    // This must already be owned by a StrongPtr, e.g., from
+    // ProcessManager::Create().
+    bool AddPrerequisite(StrongPtr p) { return p->AddDependent(shared_from_this()); }
+
+    uint32 PendingPrerequisites() const { return m_pendingPrerequisites; }
+    bool   HasDependents()        const { return !m_dependents.empty(); }
+
+    // Takes effect in the next ProcessManager::Update().
+    void            SetPriority(ProcessPriority priority) { m_priority = priority; }
+    ProcessPriority Priority() const { return m_priority; }
+
+    // Takes effect in the next ProcessManager::Update().
+    void            SetDispatch(ProcessDispatch dispatch) { m_dispatch = dispatch; }
+    ProcessDispatch Dispatch() const { return m_dispatch; }
+
+    // A hint that the process must be updated at least this often, even
+    // when ProcessManager::Update() is over budget; 0 for no minimum.
+    void SetMinUpdateRate(float32 updatesPerSecond)
+    {
+        m_minUpdateInterval = (updatesPerSecond > 0.0f ? 1000.0f / updatesPerSecond : 0.0f);
+    }
+    float32 MinUpdateRate() const { return (m_minUpdateInterval > 0.0f ? 1000.0f / m_minUpdateInterval : 0.0f); }
+
 private:
     friend class ProcessManager;
 
-    enum State m_state;
-    StrongPtr  m_child;
+    static const uint32 INVALID_INDEX = 0xFFFFFFFF;
+
+    enum State      m_state;
+    StrongPtr       m_child;
+    ProcessPriority m_priority          = ProcessPriority::Normal;
+    ProcessDispatch m_dispatch          = ProcessDispatch::MainThread;
+    DeltaTime       m_minUpdateInterval = 0.0f;
+    DeltaTime       m_elapsed           = 0.0f; // Since the last OnUpdate().
+
+    std::vector<StrongPtr> m_dependents;
+    uint32                 m_pendingPrerequisites = 0;
+    bool                   m_attached             = false; // To a ProcessManager's update list.
+    std::vector<WeakPtr>   m_deathWaiters; // See SleepUntilProcess().
+
+    std::unique_ptr<ProcessMetrics> m_metrics;
+
+    // While sleeping, where ProcessManager keeps the process.
+    bool      m_wakeOnTime  = false;
+    bool      m_wakeOnEvent = false;
+    TimeStamp m_wakeTime    = 0;
+    UUID      m_wakeEvent   = 0;
+    Process*  m_wakeProcess = nullptr;
+    uint32    m_sleepIndex  = INVALID_INDEX;
+    uint32    m_eventIndex  = INVALID_INDEX;
+    TimerWheel<Process*>::Handle m_wakeTimer;
+    ProcessManager*              m_sleepManager = nullptr; // Whose m_sleeping holds it.
+
+    bool Sleep_()
+    {
+        if (m_state == State::Running)
+            ClearWake_();
+        else if (m_state != State::Sleeping)
+            return false;
+        m_state = State::Sleeping;
+        return true;
+    }
+
+    void ClearWake_()
+    {
+        m_wakeOnTime  = false;
+        m_wakeOnEvent = false;
+        m_wakeProcess = nullptr;
+    }
+
+    // Demangled once per type; Visual C++'s names are readable already.
+    static const char* TypeName_(const std::type_info& type)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<std::type_index, std::string> names;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = names.find(type);
+        if (it == names.end())
+        {
+            #if defined(COMPILER_CLANG) || defined(COMPILER_GCC) || defined(COMPILER_MINGW)
+                int   status    = 0;
+                char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+                it = names.emplace(type, (status == 0 && demangled ? demangled : type.name())).first;
+                std::free(demangled);
+            #else
+                it = names.emplace(type, type.name()).first;
+            #endif
+        }
+        return it->second.c_str();
+    }
+
+    // For a process that was never attached; its death waiters are woken
+    // when it is, see ProcessManager::Attach().
+    void AbortUnstarted_()
+    {
+        m_state = State::Aborted;
+        std::vector<StrongPtr> dependents;
+        dependents.swap(m_dependents);
+        for (StrongPtr& d : dependents)
+        {
+            d->m_pendingPrerequisites--;
+            if (d->m_state == State::Uninitialized)
+                d->AbortUnstarted_();
+        }
+    }
 };
 
+static_assert((uint32)Process::State::Aborted + 1 == ProcessMetrics::NUM_STATES, "ProcessMetrics::NUM_STATES is out of date.");
+
+// Processes live in one contiguous array per priority, in the order they
+// were attached; dead processes' slots are emptied during Update() and
+// compacted after it in one pass. Spawn() allocates a process and its
+// control block as one block from a pool per process type. Sleeping
+// processes are moved out to a timer wheel and per event type lists until
+// they wake.
+// @warning The App's EventBus must outlive the ProcessManager.
 class ProcessManager
 {
 public:
+    ProcessManager() : m_timerTickLength(TimerTickLength_()), m_timers(TimerTick_(App::Time())) {}
     ~ProcessManager() { AbortAll(true); }
 
-    void Update(DeltaTime dt)
+    // Critical processes are always updated; the rest stop once
+    // maxMilliseconds have elapsed and resume, round-robin, from the first
+    // one skipped in the next Update(). A skipped process gets all the time it
+    // missed as dt when it's next updated, and is updated regardless of the
+    // budget once it's gone longer than its minimum update rate allows.
+    void Update(DeltaTime dt, bool limitTime = false, DeltaTime maxMilliseconds = 0.0f)
     {
+        TimeStamp startTime = App::Time();
+
         m_lastSuccessCount = 0;
         m_lastFailCount    = 0;
+        m_lastSkipCount    = 0;
 
-        auto it = m_processList.begin();
-        while (it != m_processList.end())
-        {
-            Process::StrongPtr p = (*it);
-            auto thisIt = it++;
-
-            if (p->State() == Process::State::Uninitialized)
-                p->OnInit();
+        m_timers.Advance(TimerTick_(startTime), [this](Process* p) { Wake_(*p); });
+        if (m_metricsEnabled)
+            m_lastTop.clear();
 
-            // Ignore Process::State::Removed.
+        // Processes attached during the update are appended past these, so
+        // they wait until the next update like they always have.
+        uint32 counts[NUM_PRIORITIES];
+        for (uint32 l = 0; l < NUM_PRIORITIES; l++)
+            counts[l] = m_lanes[l].processes.size();
 
-            if (p->State() == Process::State::Running)
-                p->OnUpdate(dt);
+        // Slots are only emptied, never moved, until everything's settled.
+        bool removed[NUM_PRIORITIES] = {};
 
-            // Don't update if paused.
+        bool outOfTime = false;
+        for (uint32 l = 0; l < NUM_PRIORITIES; l++)
+        {
+            Lane_& lane     = m_lanes[l];
+            uint32 n        = counts[l];
+            uint32 start    = (lane.cursor < n ? lane.cursor : 0);
+            bool   budgeted = (limitTime && l != (uint32)ProcessPriority::Critical);
+            bool   skipped  = false;
 
-            if (p->IsDead())
+            for (uint32 k = 0; k < n; k++)
             {
-                enum Process::State s = p->State();
+                uint32   i = (start + k < n ? start + k : start + k - n);
+                Process* p = lane.processes[i].get();
+                if (m_metricsEnabled)
+                    Observe_(*p);
 
-                if (s == Process::State::Succeeded)
+                if ((uint32)p->m_priority != l)
                 {
-                    p->OnSuccess();
-                    Process::StrongPtr c = p->RemoveChild();
-                    if (c)
-                        Attach(c);
-                    else // The last child succeeded, so we can count a success.
-                        m_lastSuccessCount++;
+                    m_lanes[(uint32)p->m_priority].processes.push_back(std::move(lane.processes[i]));
+                    removed[l] = true;
+                    continue;
                 }
-                else if (s == Process::State::Failed)
+
+                bool waiting = (p->State() == Process::State::Running || p->State() == Process::State::Uninitialized);
+                if (waiting)
+                    p->m_elapsed += dt;
+
+                bool run = (!outOfTime || !budgeted ||
+                            (p->m_minUpdateInterval > 0.0f && p->m_elapsed >= p->m_minUpdateInterval));
+                if (!run && waiting)
                 {
-                    p->OnFail();
-                    m_lastFailCount++;
+                    if (!skipped)
+                        lane.cursor = i;
+                    skipped = true;
+                    m_lastSkipCount++;
+                    if (m_metricsEnabled && p->m_metrics)
+                        p->m_metrics->skips++;
+                    continue;
                 }
-                else if (s == Process::State::Aborted)
+
+                if (p->State() == Process::State::Uninitialized)
+                    p->OnInit();
+
+                // Ignore Process::State::Removed.
+
+                if (p->State() == Process::State::Running)
                 {
-                    p->OnAbort();
-                    m_lastFailCount++;
+                    DeltaTime elapsed = p->m_elapsed;
+                    p->m_elapsed = 0.0f;
+                    if (m_threadPool && p->m_dispatch == ProcessDispatch::Concurrent)
+                    {
+                        UpdateConcurrent_(p, elapsed, l, i);
+                        continue; // Settled after the join.
+                    }
+
+                    if (m_metricsEnabled && p->m_metrics)
+                    {
+                        TimeStamp updateStart = App::Time();
+                        p->OnUpdate(elapsed);
+                        p->m_metrics->RecordUpdate(App::Time() - updateStart);
+                        Sample_(*p);
+                    }
+                    else
+                    {
+                        p->OnUpdate(elapsed);
+                    }
                 }
 
-                m_processList.erase(thisIt);
+                // Don't update if paused.
+
+                if (m_metricsEnabled)
+                    Observe_(*p);
+
+                if (budgeted && !outOfTime && App::MillisecondsElapsed(startTime) >= maxMilliseconds)
+                    outOfTime = true;
+
+                if (Settle_(lane, i))
+                    removed[l] = true;
             }
         }
+
+        // Concurrent processes are settled in the order they were visited, so
+        // callbacks and attachments don't depend on which worker ran what.
+        if (WaitConcurrent_())
+        {
+            for (const ConcurrentSlot_& c : m_concurrentSlots)
+            {
+                Process* p = m_lanes[c.lane].processes[c.index].get();
+                if (m_metricsEnabled && p->m_metrics)
+                {
+                    Sample_(*p);
+                    Observe_(*p);
+                }
+                if (Settle_(m_lanes[c.lane], c.index))
+                    removed[c.lane] = true;
+            }
+            m_concurrentSlots.clear();
+        }
+
+        for (uint32 l = 0; l < NUM_PRIORITIES; l++)
+        {
+            if (removed[l])
+                Compact_(m_lanes[l]);
+        }
+
+        m_lastUpdateMilliseconds = App::MillisecondsElapsed(startTime);
     }
 
+    // Concurrent processes' OnUpdate()s are run on pool; nullptr runs every
+    // process on the thread calling Update().
+    void SetThreadPool(ThreadPool* pool) { m_threadPool = pool; }
+
+    // A process with prerequisites is attached once they've succeeded; one
+    // that was aborted before it was attached, because a prerequisite had
+    // already failed, never is.
     Process::WeakPtr Attach(Process::StrongPtr p)
     {
-        m_processList.push_front(p);
+        if (p->m_state == Process::State::Aborted && !p->m_attached)
+        {
+            WakeDeathWaiters_(*p);
+            return Process::WeakPtr(p);
+        }
+        if (p->m_pendingPrerequisites > 0)
+            return Process::WeakPtr(p);
+        p->m_attached = true;
+        m_lanes[(uint32)p->m_priority].processes.push_back(p);
         return Process::WeakPtr(p);
     }
 
+    // Preferred over Attach(std::make_shared<T>()), which goes to the heap.
+    template<class T, class... Args>
+    Process::WeakPtr Spawn(Args&&... args)
+    {
+        return Attach(Create<T>(std::forward<Args>(args)...));
+    }
+
+    // For building chains to hand to Attach() or Process::AttachChild().
+    template<class T, class... Args>
+    static std::shared_ptr<T> Create(Args&&... args)
+    {
+        return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+    }
+
+    // Wakes a sleeping process early, in whichever ProcessManager it's in.
+    void Wake(Process& p)
+    {
+        if (p.m_sleepManager && p.m_sleepManager != this)
+            p.m_sleepManager->Wake(p);
+        else if (p.m_sleepIndex != Process::INVALID_INDEX && p.m_sleepIndex < m_sleeping.size() &&
+            m_sleeping[p.m_sleepIndex].get() == &p)
+            Wake_(p);
+        else if (p.m_state == Process::State::Sleeping) // Still on the update list.
+        {
+            p.ClearWake_();
+            p.m_state = Process::State::Running;
+        }
+    }
+
     // If immediate == true, immediately call OnAbort() and destory.
     void AbortAll(bool immediate)
     {
-        auto it = m_processList.begin();
-        while (it != m_processList.end())
-        {
-            auto tempIt = it;
-            it++;
+        while (!m_sleeping.empty())
+            Wake_(*m_sleeping.back());
+        if (immediate)
+            m_eventSleepers.clear();
 
-            Process::StrongPtr p = *tempIt;
-            if (p->IsAlive())
+        for (Lane_& lane : m_lanes)
+        {
+            for (uint32 i = lane.processes.size(); i-- > 0;)
             {
-                p->m_state = Process::State::Aborted;
-                if (immediate)
+                Process::StrongPtr p = lane.processes[i];
+                if (p && p->IsAlive())
                 {
-                    p->OnAbort();
-                    m_processList.erase(tempIt);
+                    p->m_state = Process::State::Aborted;
+                    if (immediate)
+                    {
+                        p->OnAbort();
+                        AbortDependents_(*p);
+                        lane.processes[i].reset();
+                    }
                 }
             }
+            if (immediate)
+                Compact_(lane);
         }
     }
 
-    uint32 Count()            const { return m_processList.size(); }
-    uint32 LastSuccessCount() const { return m_lastSuccessCount;   }
-    uint32 LastFailCount()    const { return m_lastFailCount;      }
+    // Reserves room for count processes of a priority, e.g., before spawning
+    // a wave of them.
+    void Reserve(ProcessPriority priority, uint32 count) { m_lanes[(uint32)priority].processes.reserve(count); }
+
+    uint32 Count() const
+    {
+        uint32 count = 0;
+        for (const Lane_& lane : m_lanes)
+            count += lane.processes.size();
+        return count + m_sleeping.size();
+    }
+
+    uint32 SleepingCount() const { return m_sleeping.size(); }
+
+    uint32 LastSuccessCount() const { return m_lastSuccessCount; }
+    uint32 LastFailCount()    const { return m_lastFailCount;    }
+    // Processes the last Update() ran out of time for.
+    uint32 LastSkipCount()    const { return m_lastSkipCount;    }
+
+    DeltaTime LastUpdateMilliseconds() const { return m_lastUpdateMilliseconds; }
+
+    // Opt-in, since it times every OnUpdate(); see Process::Metrics() and
+    // LastTop(), which keeps the topCount longest OnUpdate()s of each
+    // Update().
+    void SetMetricsEnabled(bool enabled, uint32 topCount = 8)
+    {
+        m_metricsEnabled = enabled;
+        m_topCount       = topCount;
+        m_lastTop.clear();
+        m_lastTop.reserve(topCount);
+    }
+    bool MetricsEnabled() const { return m_metricsEnabled; }
+
+    // Longest first.
+    const std::vector<ProcessSample>& LastTop() const { return m_lastTop; }
+
+    // Logs LastTop() under label, e.g., once a second.
+    void LogTop(const char* label) const
+    {
+        LogDebug("%s processes: %u, %.3f ms.", label, Count(), m_lastUpdateMilliseconds);
+        for (const ProcessSample& s : m_lastTop)
+            LogDebug("    %8.3f ms %s", s.milliseconds, s.name);
+    }
 
 private:
-    typedef std::list<Process::StrongPtr> ProcessList;
+    static const uint32 NUM_PRIORITIES = (uint32)ProcessPriority::Count;
+
+    struct Lane_
+    {
+        std::vector<Process::StrongPtr> processes;
+        uint32                          cursor = 0; // Where the next Update() starts.
+    };
+
+    struct EventSleepers_
+    {
+        EventBus::Subscription subscription;
+        std::vector<Process*>  processes;
+    };
+
+    struct ConcurrentUpdate_
+    {
+        Process*  process;
+        DeltaTime dt;
+    };
+
+    struct ConcurrentSlot_
+    {
+        uint32 lane;
+        uint32 index;
+    };
+
+    static const uint32 CONCURRENT_BATCH_SIZE = 32;
+
+    Lane_  m_lanes[NUM_PRIORITIES];
+
+    ThreadPool*                    m_threadPool = nullptr;
+    ThreadPool::TaskGroup          m_concurrentTasks;
+    std::vector<ConcurrentUpdate_> m_concurrentBatch;
+    std::vector<ConcurrentSlot_>   m_concurrentSlots; // Everything dispatched this Update().
+
+    std::vector<Process::StrongPtr>          m_sleeping; // Owns sleepers.
+    std::unordered_map<UUID, EventSleepers_> m_eventSleepers;
+    TimeStamp                                m_timerTickLength; // In App::Time() units.
+    TimerWheel<Process*>                     m_timers;
+
+    uint32    m_lastSuccessCount       = 0;
+    uint32    m_lastFailCount          = 0;
+    uint32    m_lastSkipCount          = 0;
+    DeltaTime m_lastUpdateMilliseconds = 0.0f;
+
+    bool                       m_metricsEnabled = false;
+    uint32                     m_topCount       = 0;
+    std::vector<ProcessSample> m_lastTop;
+
+    // Moves a dead or sleeping process out of its slot, dead ones after
+    // their callbacks; returns true if the slot was emptied.
+    bool Settle_(Lane_& lane, uint32 i)
+    {
+        Process* p = lane.processes[i].get();
+        if (p->IsDead())
+        {
+            // Out of the array before the callbacks, which may Attach().
+            Process::StrongPtr dead = std::move(lane.processes[i]);
+            WakeDeathWaiters_(*p);
+
+            enum Process::State s = p->State();
+
+            if (s == Process::State::Succeeded)
+            {
+                p->OnSuccess();
+                Process::StrongPtr c = p->RemoveChild();
+                if (c)
+                    Attach(c);
+                bool released = ReleaseDependents_(*p);
+                if (!c && !released) // The last child succeeded, so we can count a success.
+                    m_lastSuccessCount++;
+            }
+            else if (s == Process::State::Failed)
+            {
+                p->OnFail();
+                AbortDependents_(*p);
+                m_lastFailCount++;
+            }
+            else if (s == Process::State::Aborted)
+            {
+                p->OnAbort();
+                AbortDependents_(*p);
+                m_lastFailCount++;
+            }
+            return true;
+        }
+        else if (p->State() == Process::State::Sleeping)
+        {
+            Sleep_(std::move(lane.processes[i]));
+            return true;
+        }
+        return false;
+    }
+
+    void WakeDeathWaiters_(Process& p)
+    {
+        std::vector<Process::WeakPtr> waiters;
+        waiters.swap(p.m_deathWaiters);
+        for (Process::WeakPtr& w : waiters)
+        {
+            Process::StrongPtr sp = w.lock();
+            if (sp && sp->m_wakeProcess == &p)
+                Wake(*sp);
+        }
+    }
+
+    // Returns false if p had no dependents.
+    bool ReleaseDependents_(Process& p)
+    {
+        if (p.m_dependents.empty())
+            return false;
+
+        std::vector<Process::StrongPtr> dependents;
+        dependents.swap(p.m_dependents);
+        for (Process::StrongPtr& d : dependents)
+        {
+            if (--d->m_pendingPrerequisites == 0 && d->State() == Process::State::Uninitialized)
+                Attach(std::move(d));
+        }
+        return true;
+    }
+
+    // Dependents never started, so they're marked aborted without OnAbort(),
+    // like a failed process' child chain.
+    void AbortDependents_(Process& p)
+    {
+        std::vector<Process::StrongPtr> dependents;
+        dependents.swap(p.m_dependents);
+        for (Process::StrongPtr& d : dependents)
+        {
+            d->m_pendingPrerequisites--;
+            if (d->State() == Process::State::Uninitialized)
+            {
+                d->m_state = Process::State::Aborted;
+                WakeDeathWaiters_(*d);
+                AbortDependents_(*d);
+            }
+        }
+    }
+
+    void UpdateConcurrent_(Process* p, DeltaTime dt, uint32 lane, uint32 index)
+    {
+        m_concurrentSlots.push_back(ConcurrentSlot_{lane, index});
+        m_concurrentBatch.push_back(ConcurrentUpdate_{p, dt});
+        if (m_concurrentBatch.size() >= CONCURRENT_BATCH_SIZE)
+            SubmitConcurrentBatch_();
+    }
+
+    void SubmitConcurrentBatch_()
+    {
+        // Each process' metrics are only touched by the worker updating it.
+        m_threadPool->Submit(m_concurrentTasks, [batch = std::move(m_concurrentBatch), timed = m_metricsEnabled]
+        {
+            for (const ConcurrentUpdate_& u : batch)
+            {
+                if (timed && u.process->m_metrics)
+                {
+                    TimeStamp updateStart = App::Time();
+                    u.process->OnUpdate(u.dt);
+                    u.process->m_metrics->RecordUpdate(App::Time() - updateStart);
+                }
+                else
+                {
+                    u.process->OnUpdate(u.dt);
+                }
+            }
+        });
+        m_concurrentBatch.clear();
+    }
+
+    // Counts p's state transitions since it was last observed.
+    void Observe_(Process& p)
+    {
+        uint32 state = (uint32)p.m_state;
+        if (!p.m_metrics)
+        {
+            p.m_metrics.reset(new (std::nothrow) ProcessMetrics);
+            if (!p.m_metrics)
+                return;
+            p.m_metrics->firstSeen = App::Time();
+        }
+        else if (p.m_metrics->lastState == state)
+        {
+            return;
+        }
+
+        p.m_metrics->transitions[state]++;
+        p.m_metrics->lastState = state;
+    }
+
+    // Keeps LastTop() sorted, longest first.
+    void Sample_(const Process& p)
+    {
+        DeltaTime ms = p.m_metrics->lastMilliseconds;
+        if (m_lastTop.size() >= m_topCount && (m_topCount == 0 || ms <= m_lastTop.back().milliseconds))
+            return;
+
+        if (m_lastTop.size() >= m_topCount)
+            m_lastTop.pop_back();
+
+        uint32 at = m_lastTop.size();
+        while (at > 0 && m_lastTop[at - 1].milliseconds < ms)
+            at--;
+
+        ProcessSample s;
+        std::strncpy(s.name, p.Name(), sizeof(s.name) - 1);
+        s.name[sizeof(s.name) - 1] = '\0';
+        s.milliseconds = ms;
+        m_lastTop.insert(m_lastTop.begin() + at, s);
+    }
+
+    // Returns false if nothing was dispatched.
+    bool WaitConcurrent_()
+    {
+        if (m_concurrentSlots.empty())
+            return false;
+
+        if (!m_concurrentBatch.empty())
+            SubmitConcurrentBatch_();
+        m_threadPool->Wait(m_concurrentTasks);
+        return true;
+    }
+
+    static TimeStamp TimerTickLength_()
+    {
+        TimeStamp length = App::TimePerSecond() / 1000;
+        return (length ? length : 1);
+    }
+
+    uint64 TimerTick_(TimeStamp time) const { return time / m_timerTickLength; }
+
+    void Sleep_(Process::StrongPtr&& sp)
+    {
+        Process& p = *sp;
+        p.m_elapsed    = 0.0f;
+        p.m_sleepIndex   = m_sleeping.size();
+        p.m_sleepManager = this;
+        m_sleeping.push_back(std::move(sp));
+
+        // Rounded up, so it never wakes before m_wakeTime.
+        if (p.m_wakeOnTime)
+            p.m_wakeTimer = m_timers.Schedule(TimerTick_(p.m_wakeTime) + (p.m_wakeTime % m_timerTickLength ? 1 : 0), &p);
 
-    ProcessList m_processList;
-    uint32 m_lastSuccessCount;
-    uint32 m_lastFailCount;
+        if (p.m_wakeOnEvent)
+        {
+            EventSleepers_& es = m_eventSleepers[p.m_wakeEvent];
+            if (!es.subscription.IsSubscribed())
+            {
+                UUID type = p.m_wakeEvent;
+                es.subscription = App::Get().Events()->Subscribe([this, type](IEvent&) { WakeOnEvent_(type); }, type);
+            }
+            p.m_eventIndex = es.processes.size();
+            es.processes.push_back(&p);
+        }
+    }
+
+    void Wake_(Process& p)
+    {
+        if (p.m_wakeOnTime)
+            m_timers.Cancel(p.m_wakeTimer);
+
+        if (p.m_eventIndex != Process::INVALID_INDEX)
+        {
+            std::vector<Process*>& ps = m_eventSleepers[p.m_wakeEvent].processes;
+            if (p.m_eventIndex != ps.size() - 1)
+            {
+                ps[p.m_eventIndex] = ps.back();
+                ps[p.m_eventIndex]->m_eventIndex = p.m_eventIndex;
+            }
+            ps.pop_back();
+        }
+
+        uint32 i = p.m_sleepIndex;
+        Process::StrongPtr sp = std::move(m_sleeping[i]);
+        if (i != m_sleeping.size() - 1)
+        {
+            m_sleeping[i] = std::move(m_sleeping.back());
+            m_sleeping[i]->m_sleepIndex = i;
+        }
+        m_sleeping.pop_back();
+
+        p.ClearWake_();
+        p.m_sleepIndex   = Process::INVALID_INDEX;
+        p.m_sleepManager = nullptr;
+        p.m_eventIndex   = Process::INVALID_INDEX;
+        p.m_state       = Process::State::Running;
+        if (m_metricsEnabled && p.m_metrics)
+            Observe_(p);
+        Attach(sp);
+    }
+
+    void WakeOnEvent_(UUID type)
+    {
+        auto it = m_eventSleepers.find(type);
+        if (it == m_eventSleepers.end())
+            return;
+
+        std::vector<Process*> woken;
+        woken.swap(it->second.processes);
+        for (Process* p : woken)
+        {
+            p->m_eventIndex = Process::INVALID_INDEX;
+            Wake_(*p);
+        }
+    }
+
+    // Removes the emptied slots, keeping the rest in order and the cursor on
+    // the same process, or the next one if its slot was emptied, so
+    // round-robin resumes where it left off.
+    static void Compact_(Lane_& lane)
+    {
+        uint32 n      = lane.processes.size();
+        uint32 cursor = 0;
+        uint32 kept   = 0;
+        for (uint32 i = 0; i < n; i++)
+        {
+            if (i == lane.cursor)
+                cursor = kept;
+            if (lane.processes[i])
+                lane.processes[kept++] = std::move(lane.processes[i]);
+        }
+        lane.processes.resize(kept);
+        lane.cursor = cursor;
+    }
 };
 
 #endif // PROCESS_MANAGER_HPP
@@ -0,0 +1,75 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef PROCESS_METRICS_HPP
+#define PROCESS_METRICS_HPP
+
+#include "global.hpp"
+#include "app.hpp"
+#include "event_metrics.hpp" // TimeHistogram
+
+// Per process, while its ProcessManager has metrics enabled; see
+// Process::Metrics().
+struct ProcessMetrics
+{
+    static const uint32 NUM_STATES    = 8;  // Process::State
+    static const uint32 WINDOW_LENGTH = 60; // Updates per max window.
+
+    TimeStamp firstSeen = 0; // App::Time() of the first Update() that saw it.
+    uint64    updates   = 0;
+    uint64    skips     = 0; // Left for the next Update() when out of time.
+
+    // Times the process has entered each Process::State.
+    uint32 transitions[NUM_STATES] = {};
+    uint32 lastState               = 0;
+
+    DeltaTime lastMilliseconds    = 0.0f; // Of the last OnUpdate().
+    DeltaTime averageMilliseconds = 0.0f; // Exponential moving average.
+    // Longest OnUpdate() in this window or the last full one, so a spike
+    // shows for at least WINDOW_LENGTH updates.
+    DeltaTime recentMaxMilliseconds = 0.0f;
+
+    TimeHistogram update; // Every OnUpdate() since firstSeen.
+
+    void RecordUpdate(TimeStamp ticks)
+    {
+        update.Record(ticks);
+        lastMilliseconds = (DeltaTime)ticks * 1000.0f / (DeltaTime)App::TimePerSecond();
+        averageMilliseconds = (updates == 0 ? lastMilliseconds :
+                               averageMilliseconds + (lastMilliseconds - averageMilliseconds) * AVERAGE_WEIGHT);
+        updates++;
+
+        if (lastMilliseconds > m_windowMax)
+            m_windowMax = lastMilliseconds;
+        if (++m_windowCount >= WINDOW_LENGTH)
+        {
+            m_lastWindowMax = m_windowMax;
+            m_windowMax     = 0.0f;
+            m_windowCount   = 0;
+        }
+        recentMaxMilliseconds = (m_windowMax > m_lastWindowMax ? m_windowMax : m_lastWindowMax);
+    }
+
+    DeltaTime LifetimeMilliseconds() const { return App::MillisecondsElapsed(firstSeen); }
+
+private:
+    static constexpr float32 AVERAGE_WEIGHT = 0.1f;
+
+    DeltaTime m_windowMax     = 0.0f;
+    DeltaTime m_lastWindowMax = 0.0f;
+    uint32    m_windowCount   = 0;
+};
+
+// One of the processes that took longest in a ProcessManager::Update(); see
+// ProcessManager::LastTop().
+struct ProcessSample
+{
+    char      name[48];
+    DeltaTime milliseconds;
+};
+
+#endif // PROCESS_METRICS_HPP
@@ -0,0 +1,109 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include "global.hpp"
+
+#include <utility> // move
+#include <vector>
+
+// Fixed-capacity double-ended queue in one allocation; capacity is rounded up
+// to a power of two. Pushing to a full buffer fails rather than allocating,
+// unless the owner explicitly Grow()s it.
+template<class T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(uint32 capacity = 0) { SetCapacity(capacity); }
+
+    // Drops what doesn't fit, from the back.
+    void SetCapacity(uint32 capacity)
+    {
+        uint32 c = 1;
+        while (c < capacity)
+            c <<= 1;
+
+        std::vector<T> items(c);
+        uint32 n = (m_size < c ? m_size : c);
+        for (uint32 i = 0; i < n; i++)
+            items[i] = std::move((*this)[i]);
+
+        m_items.swap(items);
+        m_mask  = c - 1;
+        m_head  = 0;
+        m_size  = n;
+    }
+
+    void Grow() { SetCapacity(Capacity() * 2); }
+
+    uint32 Capacity() const { return m_items.size(); }
+    uint32 Size()     const { return m_size; }
+    bool   Empty()    const { return m_size == 0; }
+    bool   Full()     const { return m_size == m_items.size(); }
+
+    // From the front.
+    T&       operator[](uint32 i)       { return m_items[(m_head + i) & m_mask]; }
+    const T& operator[](uint32 i) const { return m_items[(m_head + i) & m_mask]; }
+
+    T& Front() { return m_items[m_head]; }
+    T& Back()  { return (*this)[m_size - 1]; }
+
+    bool PushBack(T v)
+    {
+        if (Full())
+            return false;
+        (*this)[m_size] = std::move(v);
+        m_size++;
+        return true;
+    }
+
+    bool PushFront(T v)
+    {
+        if (Full())
+            return false;
+        m_head = (m_head - 1) & m_mask;
+        m_items[m_head] = std::move(v);
+        m_size++;
+        return true;
+    }
+
+    // The buffer mustn't be empty.
+    T PopFront()
+    {
+        T v = std::move(m_items[m_head]);
+        m_items[m_head] = T();
+        m_head = (m_head + 1) & m_mask;
+        m_size--;
+        return v;
+    }
+
+    T PopBack()
+    {
+        T& back = Back();
+        T v = std::move(back);
+        back = T();
+        m_size--;
+        return v;
+    }
+
+    void Clear()
+    {
+        while (m_size > 0)
+            PopBack();
+        m_head = 0;
+    }
+
+private:
+    std::vector<T> m_items;
+    uint32 m_mask = 0;
+    uint32 m_head = 0;
+    uint32 m_size = 0;
+};
+
+#endif // RING_BUFFER_HPP
@@ -0,0 +1,257 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef SYSTEM_SCHEDULER_HPP
+#define SYSTEM_SCHEDULER_HPP
+
+// Runs EntityManager systems in parallel where their declared component
+// access allows:
+//
+//     systems.Add("Gravity", SystemAccess().Reads<Mass>().Writes<Velocity>(),
+//                 [](SystemContext& c)
+//     {
+//         c.Each<const Mass, Velocity>([&c](const Mass& m, Velocity& v) { ... });
+//     });
+//     systems.Add("Movement", SystemAccess().Reads<Velocity>().Writes<Position>(), ...);
+//     systems.Add("Animation", SystemAccess().Writes<Pose>(), ...);
+//
+// Movement reads what Gravity writes, so it runs after Gravity; Animation
+// shares nothing with either, so it runs alongside them. Systems that
+// conflict run in the order they were added, and each system's own queries
+// are split across the pool too.
+//
+// Exclusive systems run alone on the calling thread (their queries still use
+// the pool), between the systems added before and after them. Only they may
+// create, destroy, add or remove, or touch anything outside the EntityManager
+// that isn't thread-safe.
+
+#include "global.hpp"
+#include "app.hpp"
+#include "entity_manager.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory> // unique_ptr
+#include <string>
+#include <type_traits> // is_const/remove_cv
+#include <utility> // move
+#include <vector>
+
+class SystemAccess
+{
+public:
+    template<class... Ts>
+    SystemAccess& Reads() { m_reads |= (ComponentTypes::Mask<Ts>() | ... | (ComponentMask)0); return *this; }
+
+    template<class... Ts>
+    SystemAccess& Writes() { m_writes |= (ComponentTypes::Mask<Ts>() | ... | (ComponentMask)0); return *this; }
+
+    SystemAccess& Exclusive() { m_exclusive = true; return *this; }
+
+    ComponentMask ReadMask()    const { return m_reads; }
+    ComponentMask WriteMask()   const { return m_writes; }
+    bool          IsExclusive() const { return m_exclusive; }
+
+    // True if running alongside o could race.
+    bool ConflictsWith(const SystemAccess& o) const
+    {
+        return (m_exclusive || o.m_exclusive ||
+                (m_writes & (o.m_reads | o.m_writes)) ||
+                (o.m_writes & m_reads));
+    }
+
+private:
+    ComponentMask m_reads     = 0;
+    ComponentMask m_writes    = 0;
+    bool          m_exclusive = false;
+};
+
+// What a system gets each frame.
+class SystemContext
+{
+public:
+    EntityManager& entities;
+    DeltaTime      dt;
+
+    SystemContext(EntityManager& e, DeltaTime d, ThreadPool* pool, const SystemAccess& access)
+        : entities(e), dt(d), m_pool(pool), m_access(access) {}
+
+    // EntityManager::Each() on the pool; Ts must be within the system's
+    // access, and const unless it writes them.
+    template<class... Ts, class F>
+    void Each(F&& f)
+    {
+        SDL_assert(Allowed_<Ts...>());
+        if (m_pool)
+            entities.ParallelEach<Ts...>(*m_pool, f);
+        else
+            entities.Each<Ts...>(f);
+    }
+
+    template<class... Ts, class F>
+    void EachChunk(F&& f)
+    {
+        SDL_assert(Allowed_<Ts...>());
+        if (m_pool)
+            entities.ParallelEachChunk<Ts...>(*m_pool, f);
+        else
+            entities.EachChunk<Ts...>(f);
+    }
+
+private:
+    ThreadPool*         m_pool;
+    const SystemAccess& m_access;
+
+    template<class... Ts>
+    bool Allowed_() const
+    {
+        if (m_access.IsExclusive())
+            return true;
+        return ((std::is_const_v<Ts> ?
+                 (m_access.ReadMask() | m_access.WriteMask()) & ComponentTypes::Mask<Ts>() :
+                 m_access.WriteMask() & ComponentTypes::Mask<Ts>()) && ...);
+    }
+};
+
+class SystemScheduler
+{
+public:
+    typedef std::function<void(SystemContext&)> SystemFunction;
+
+    // nullptr runs every system and query on the calling thread.
+    void SetThreadPool(ThreadPool* pool) { m_pool = pool; }
+
+    // Runs after every conflicting system already added; returns its index.
+    uint32 Add(std::string name, const SystemAccess& access, SystemFunction run)
+    {
+        std::unique_ptr<System_> s(new System_);
+        s->name   = std::move(name);
+        s->access = access;
+        s->run    = std::move(run);
+        m_systems.push_back(std::move(s));
+        m_built = false;
+        return (uint32)m_systems.size() - 1;
+    }
+
+    uint32             Count()             const { return (uint32)m_systems.size(); }
+    const std::string& Name(uint32 system) const { return m_systems[system]->name; }
+    // Of the last Run().
+    DeltaTime LastMilliseconds(uint32 system) const { return m_systems[system]->milliseconds; }
+
+    void Run(EntityManager& entities, DeltaTime dt)
+    {
+        if (!m_built)
+            Build_();
+
+        // Between exclusive systems, run the rest as a graph.
+        uint32 first = 0;
+        while (first < m_systems.size())
+        {
+            uint32 last = first;
+            while (last < m_systems.size() && !m_systems[last]->access.IsExclusive())
+                last++;
+
+            if (last > first)
+                RunGraph_(entities, dt, first, last);
+            if (last < m_systems.size())
+                RunSystem_(*m_systems[last], entities, dt, m_pool);
+            first = last + 1;
+        }
+    }
+
+private:
+    struct System_
+    {
+        std::string    name;
+        SystemAccess   access;
+        SystemFunction run;
+
+        // Later conflicting systems in the same stretch between exclusives.
+        std::vector<uint32> dependents;
+        uint32              prerequisites = 0;
+        std::atomic<uint32> pending{0}; // Prerequisites left this frame.
+        DeltaTime           milliseconds = 0.0f;
+    };
+
+    ThreadPool*                           m_pool  = nullptr;
+    std::vector<std::unique_ptr<System_>> m_systems;
+    bool                                  m_built = false;
+
+    // Edges run from each system to every later conflicting one. Redundant
+    // edges cost a decrement each, so they're left in.
+    void Build_()
+    {
+        for (auto& s : m_systems)
+        {
+            s->dependents.clear();
+            s->prerequisites = 0;
+        }
+
+        for (uint32 j = 0; j < m_systems.size(); j++)
+        {
+            if (m_systems[j]->access.IsExclusive())
+                continue;
+            for (uint32 i = j; i-- > 0 && !m_systems[i]->access.IsExclusive(); )
+            {
+                if (m_systems[i]->access.ConflictsWith(m_systems[j]->access))
+                {
+                    m_systems[i]->dependents.push_back(j);
+                    m_systems[j]->prerequisites++;
+                }
+            }
+        }
+        m_built = true;
+    }
+
+    void RunGraph_(EntityManager& entities, DeltaTime dt, uint32 first, uint32 last)
+    {
+        if (!m_pool)
+        {
+            for (uint32 i = first; i < last; i++)
+                RunSystem_(*m_systems[i], entities, dt, nullptr);
+            return;
+        }
+
+        for (uint32 i = first; i < last; i++)
+            m_systems[i]->pending.store(m_systems[i]->prerequisites, std::memory_order_relaxed);
+
+        ThreadPool::TaskGroup tasks;
+        for (uint32 i = first; i < last; i++)
+        {
+            if (m_systems[i]->prerequisites == 0)
+                Submit_(tasks, i, entities, dt);
+        }
+        m_pool->Wait(tasks);
+    }
+
+    // Dependents are submitted from the task that releases them, so a chain
+    // of systems stays on one worker unless another is idle.
+    void Submit_(ThreadPool::TaskGroup& tasks, uint32 system, EntityManager& entities, DeltaTime dt)
+    {
+        m_pool->Submit(tasks, [this, &tasks, system, &entities, dt]
+        {
+            System_& s = *m_systems[system];
+            RunSystem_(s, entities, dt, m_pool);
+            for (uint32 d : s.dependents)
+            {
+                if (m_systems[d]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    Submit_(tasks, d, entities, dt);
+            }
+        });
+    }
+
+    static void RunSystem_(System_& s, EntityManager& entities, DeltaTime dt, ThreadPool* pool)
+    {
+        TimeStamp start = App::Time();
+        SystemContext context(entities, dt, pool, s.access);
+        s.run(context);
+        s.milliseconds = App::MillisecondsElapsed(start);
+    }
+};
+
+#endif // SYSTEM_SCHEDULER_HPP
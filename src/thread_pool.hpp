@@ -0,0 +1,232 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include "global.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory> // unique_ptr
+#include <mutex>
+#include <thread>
+#include <utility> // move
+#include <vector>
+
+// Fixed set of worker threads with a work-stealing queue each. Tasks are
+// submitted to a TaskGroup, which a thread can Wait() on; the waiting thread
+// runs queued tasks itself rather than sitting idle.
+//
+// A worker submitting a task pushes it on its own queue and takes from there
+// newest first, so the tasks a task splits into stay on its core while they're
+// in cache; idle workers steal the oldest from the others. Other threads
+// submit to a shared queue that every worker takes from.
+class ThreadPool
+{
+public:
+    class TaskGroup
+    {
+    public:
+        // Tasks submitted and not yet finished.
+        uint32 Pending() const { return m_pending.load(std::memory_order_acquire); }
+
+    private:
+        friend class ThreadPool;
+        std::atomic<uint32> m_pending{0};
+    };
+
+    // 0 threads: one per core, less one for the main thread.
+    explicit ThreadPool(uint32 numThreads = 0)
+    {
+        if (numThreads == 0)
+        {
+            numThreads = std::thread::hardware_concurrency();
+            numThreads = (numThreads > 1 ? numThreads - 1 : 1);
+        }
+
+        // The last queue is the shared one.
+        for (uint32 i = 0; i <= numThreads; i++)
+            m_queues.emplace_back(new Queue_);
+
+        m_threads.reserve(numThreads);
+        for (uint32 i = 0; i < numThreads; i++)
+            m_threads.emplace_back([this, i] { WorkerLoop_(i); });
+    }
+
+    // Finishes the queued tasks first.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit.store(true, std::memory_order_release);
+        }
+        m_condition.notify_all();
+
+        for (std::thread& t : m_threads)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32 NumThreads() const { return m_threads.size(); }
+
+    void Submit(TaskGroup& g, std::function<void()> task)
+    {
+        g.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+        // Counted first, so m_queued is never less than the tasks queued.
+        m_queued.fetch_add(1, std::memory_order_seq_cst);
+        Queue_& q = *m_queues[QueueIndex_()];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(Task_{std::move(task), &g});
+        }
+
+        // Pairs with Sleep_(): either the sleeper sees the task first, or
+        // this sees the sleeper and wakes it.
+        if (m_sleeping.load(std::memory_order_seq_cst) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_one();
+        }
+    }
+
+    // Returns once every task submitted to g has finished.
+    void Wait(TaskGroup& g)
+    {
+        uint32 index = QueueIndex_();
+        while (g.Pending() > 0)
+        {
+            Task_ t;
+            if (Take_(index, t))
+                Run_(t);
+            else
+                Sleep_([&g] { return g.Pending() == 0; });
+        }
+    }
+
+private:
+    struct Task_
+    {
+        std::function<void()> run;
+        TaskGroup*            group = nullptr;
+    };
+
+    // Own cache line each, so workers taking from their own queues don't
+    // contend.
+    struct alignas(64) Queue_
+    {
+        std::mutex        mutex;
+        std::deque<Task_> tasks;
+    };
+
+    std::vector<std::thread>             m_threads;
+    std::vector<std::unique_ptr<Queue_>> m_queues;
+    std::atomic<uint32>                  m_queued{0}; // In any queue.
+    std::atomic<uint32>                  m_sleeping{0};
+    std::mutex                           m_mutex; // For m_condition.
+    // Signalled when a task is queued or a group finishes.
+    std::condition_variable              m_condition;
+    std::atomic<bool>                    m_quit{false};
+
+    // Set on this pool's workers.
+    static inline thread_local const ThreadPool* s_workerPool  = nullptr;
+    static inline thread_local uint32            s_workerIndex = 0;
+
+    uint32 QueueIndex_() const
+    {
+        return (s_workerPool == this ? s_workerIndex : (uint32)m_threads.size());
+    }
+
+    // The newest task from this worker's own queue, else the oldest from the
+    // shared queue, else the oldest from another worker's.
+    bool Take_(uint32 index, Task_& t)
+    {
+        if (m_queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        uint32 shared = (uint32)m_threads.size();
+        if (index != shared && PopBack_(*m_queues[index], t))
+            return true;
+        if (PopFront_(*m_queues[shared], t))
+            return true;
+        for (uint32 i = 0; i < shared; i++)
+        {
+            uint32 victim = (index + 1 + i) % shared;
+            if (victim != index && PopFront_(*m_queues[victim], t))
+                return true;
+        }
+        return false;
+    }
+
+    bool PopBack_(Queue_& q, Task_& t)
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            return false;
+        t = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        m_queued.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    bool PopFront_(Queue_& q, Task_& t)
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            return false;
+        t = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        m_queued.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    void Run_(Task_& t)
+    {
+        t.run();
+
+        if (t.group->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            // Lock so a Wait() between its check and its wait can't miss this.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_all();
+        }
+    }
+
+    void WorkerLoop_(uint32 index)
+    {
+        s_workerPool  = this;
+        s_workerIndex = index;
+
+        while (true)
+        {
+            Task_ t;
+            if (Take_(index, t))
+                Run_(t);
+            else if (m_quit.load(std::memory_order_acquire))
+                return; // Quitting, and nothing left.
+            else
+                Sleep_([this] { return m_quit.load(std::memory_order_acquire); });
+        }
+    }
+
+    // Until a task is queued or done() is true.
+    template<class F>
+    void Sleep_(F done)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        m_condition.wait(lock, [this, &done] { return m_queued.load(std::memory_order_seq_cst) > 0 || done(); });
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+#endif // THREAD_POOL_HPP
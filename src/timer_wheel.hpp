@@ -0,0 +1,232 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+// Hierarchical timer wheel (Varghese & Lauck): LEVELS wheels of SLOTS slots,
+// each slot a tick SLOTS times longer than the level below. Scheduling,
+// cancelling and expiring a timer are O(1); a timer is moved down a level at
+// most LEVELS - 1 times before it expires. Ticks are whatever unit the owner
+// picks, e.g., milliseconds.
+
+#include "global.hpp"
+
+#include <utility> // move
+#include <vector>
+
+template<class T>
+class TimerWheel
+{
+public:
+    static const uint32 LEVEL_BITS = 8;
+    static const uint32 SLOTS      = 1 << LEVEL_BITS;
+    static const uint32 LEVELS     = 4;
+    // Timers further out than this are clamped to it.
+    static const uint64 MAX_DELAY  = ((uint64)1 << (LEVEL_BITS * LEVELS)) - 1;
+
+    // generation is bumped whenever a timer expires or is cancelled, so
+    // stale handles are detected instead of cancelling a reused node.
+    struct Handle
+    {
+        uint32 index      = INVALID_INDEX;
+        uint32 generation = 0;
+    };
+
+    explicit TimerWheel(uint64 now = 0) : m_current(now)
+    {
+        for (uint32 l = 0; l < LEVELS; l++)
+        {
+            for (uint32 s = 0; s < SLOTS; s++)
+            {
+                m_slots[l][s].head = INVALID_INDEX;
+                m_slots[l][s].tail = INVALID_INDEX;
+            }
+        }
+    }
+
+    // Expires on the first Advance() to tick or later; ticks that have
+    // already passed expire on the next one.
+    Handle Schedule(uint64 tick, T value)
+    {
+        uint32 n = m_firstFree;
+        if (n == INVALID_INDEX)
+        {
+            n = m_nodes.size();
+            m_nodes.push_back(Node_());
+        }
+        else
+        {
+            m_firstFree = m_nodes[n].next;
+        }
+
+        if (tick <= m_current)
+            tick = m_current + 1;
+        else if (tick - m_current > MAX_DELAY)
+            tick = m_current + MAX_DELAY;
+
+        Node_& node = m_nodes[n];
+        node.value  = std::move(value);
+        node.expiry = tick;
+        node.live   = true;
+        Insert_(n);
+        m_count++;
+
+        Handle h;
+        h.index      = n;
+        h.generation = node.generation;
+        return h;
+    }
+
+    // Returns false if the timer already expired or was cancelled.
+    bool Cancel(Handle h)
+    {
+        if (h.index >= m_nodes.size())
+            return false;
+        Node_& node = m_nodes[h.index];
+        if (!node.live || node.generation != h.generation)
+            return false;
+
+        Unlink_(h.index);
+        Free_(h.index);
+        return true;
+    }
+
+    // Calls expired(T&&) for every timer due by now, in expiry order; timers
+    // due on the same tick expire in the order they were scheduled. expired
+    // may Schedule() and Cancel().
+    template<class F>
+    void Advance(uint64 now, F&& expired)
+    {
+        while (m_current < now)
+        {
+            if (m_count == 0)
+            {
+                m_current = now;
+                break;
+            }
+
+            m_current++;
+
+            // Move timers down from every level whose slot this tick starts,
+            // top first, so they can fall through to level 0 this tick.
+            for (uint32 l = LEVELS - 1; l > 0; l--)
+            {
+                if ((m_current & (((uint64)1 << (LEVEL_BITS * l)) - 1)) == 0)
+                    Cascade_(l, (m_current >> (LEVEL_BITS * l)) & (SLOTS - 1));
+            }
+
+            Slot_& slot = m_slots[0][m_current & (SLOTS - 1)];
+            while (slot.head != INVALID_INDEX)
+            {
+                uint32 n = slot.head;
+                Unlink_(n);
+                T value = std::move(m_nodes[n].value);
+                Free_(n);
+                expired(std::move(value));
+            }
+        }
+    }
+
+    uint32 Count() const { return m_count; }
+    uint64 Now()   const { return m_current; }
+
+private:
+    static const uint32 INVALID_INDEX = 0xFFFFFFFF;
+
+    struct Node_
+    {
+        T      value      = T();
+        uint64 expiry     = 0;
+        uint32 level      = 0;
+        uint32 slot       = 0;
+        uint32 prev       = INVALID_INDEX;
+        uint32 next       = INVALID_INDEX; // Also the free list.
+        uint32 generation = 0;
+        bool   live       = false;
+    };
+
+    struct Slot_
+    {
+        uint32 head;
+        uint32 tail;
+    };
+
+    std::vector<Node_> m_nodes;
+    uint32 m_firstFree = INVALID_INDEX;
+    uint32 m_count     = 0;
+    uint64 m_current; // Last tick Advance() expired.
+    Slot_  m_slots[LEVELS][SLOTS];
+
+    // Level l holds timers due 2^(8l) to 2^(8(l+1)) - 1 ticks from now, in
+    // the slot that's cascaded on the tick that starts their 2^(8l) range.
+    // Cascaded timers can be due this tick, which is expired after cascading.
+    void Insert_(uint32 n)
+    {
+        Node_& node = m_nodes[n];
+        uint64 delay = node.expiry - m_current;
+        uint32 l = 0;
+        while (l < LEVELS - 1 && delay >= ((uint64)1 << (LEVEL_BITS * (l + 1))))
+            l++;
+
+        node.level = l;
+        node.slot  = (node.expiry >> (LEVEL_BITS * l)) & (SLOTS - 1);
+        node.next  = INVALID_INDEX;
+
+        Slot_& s = m_slots[l][node.slot];
+        node.prev = s.tail;
+        if (s.tail == INVALID_INDEX)
+            s.head = n;
+        else
+            m_nodes[s.tail].next = n;
+        s.tail = n;
+    }
+
+    void Unlink_(uint32 n)
+    {
+        Node_& node = m_nodes[n];
+        Slot_& s = m_slots[node.level][node.slot];
+
+        if (node.prev == INVALID_INDEX)
+            s.head = node.next;
+        else
+            m_nodes[node.prev].next = node.next;
+
+        if (node.next == INVALID_INDEX)
+            s.tail = node.prev;
+        else
+            m_nodes[node.next].prev = node.prev;
+    }
+
+    void Free_(uint32 n)
+    {
+        Node_& node = m_nodes[n];
+        node.value = T(); // Release it now, not when the node is reused.
+        node.live  = false;
+        node.generation++;
+        node.next  = m_firstFree;
+        m_firstFree = n;
+        m_count--;
+    }
+
+    void Cascade_(uint32 level, uint32 slot)
+    {
+        Slot_& s = m_slots[level][slot];
+        uint32 n = s.head;
+        s.head = INVALID_INDEX;
+        s.tail = INVALID_INDEX;
+
+        while (n != INVALID_INDEX)
+        {
+            uint32 next = m_nodes[n].next;
+            Insert_(n);
+            n = next;
+        }
+    }
+};
+
+#endif // TIMER_WHEEL_HPP
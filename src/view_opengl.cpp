@@ -15,8 +15,6 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#include <memory> // make_shared
-
 global_variable uint32 g_cubeVBO  = 0;
 global_variable uint32 g_cubeVAO  = 0;
 global_variable uint32 g_lightVAO = 0;
@@ -28,6 +26,9 @@ bool ViewOpenGL::Init()
     m_app   = &App::Get();
     m_logic = m_app->Logic();
 
+    m_processes.SetThreadPool(m_app->Workers());
+    m_processes.SetMetricsEnabled(m_app->m_options.processes.metrics, m_app->m_options.processes.metricsTopCount);
+
     if (SDL_GL_LoadLibrary(nullptr))
     {
         LogFatal("Failed to load OpenGL library: %s.", SDL_GetError());
@@ -259,7 +260,7 @@ bool ViewOpenGL::ProcessEvents(DeltaTime dt)
         }
         else if (e.type == SDL_MOUSEMOTION)
         {
-            m_app->Events()->Publish(std::make_shared<EventRotateCamera>(e.motion.xrel, e.motion.yrel));
+            m_app->Events()->Publish<EventRotateCamera>(e.motion.xrel, e.motion.yrel);
         }
         else if (e.type == SDL_MOUSEWHEEL)
         {
@@ -267,7 +268,7 @@ bool ViewOpenGL::ProcessEvents(DeltaTime dt)
             bool in = (e.wheel.y > 0 ? true : false);
             if (e.wheel.direction == SDL_MOUSEWHEEL_FLIPPED)
                 in = -in;
-            m_app->Events()->Publish(std::make_shared<EventZoomCamera>(in));
+            m_app->Events()->Publish<EventZoomCamera>(in);
         }
     }
 
@@ -286,7 +287,7 @@ bool ViewOpenGL::ProcessEvents(DeltaTime dt)
         moveCameraRight = true;
 
     if (moveCameraForward || moveCameraBackward || moveCameraLeft || moveCameraRight)
-        m_app->Events()->Publish(std::make_shared<EventMoveCamera>(dt, moveCameraForward, moveCameraBackward, moveCameraLeft, moveCameraRight));
+        m_app->Events()->Publish<EventMoveCamera>(dt, moveCameraForward, moveCameraBackward, moveCameraLeft, moveCameraRight);
 
     if (kbState[SDL_SCANCODE_I])
         g_lightPos += glm::vec3(0.0f, 0.0f, -1.0f) * m_app->m_options.camera.speed * dt;
@@ -309,11 +310,16 @@ bool ViewOpenGL::Render(DeltaTime dt)
     if (App::SecondsElapsed(m_fpsLastTime) >= 1.0f)
     {
         LogDebug("FPS: %u, DT: %f.", m_fpsCounter, dt);
+        if (m_processes.MetricsEnabled())
+            m_processes.LogTop("View");
+        if (m_logic->Processes().MetricsEnabled())
+            m_logic->Processes().LogTop("Logic");
         m_fpsCounter = 0;
         m_fpsLastTime = App::Time();
     }
 
-    m_processes.Update(dt);
+    DeltaTime budget = m_app->m_options.processes.viewBudget;
+    m_processes.Update(dt, budget > 0.0f, budget);
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -0,0 +1,47 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#ifndef TEST_HPP
+#define TEST_HPP
+
+// Just enough for the test executables: CHECK() what should be true and
+// return TestResult() from main(), which ctest reads.
+
+#include "global.hpp"
+#include "app.hpp"
+
+#include <cstdio>
+
+inline uint32 testFailures_ = 0;
+
+#define CHECK(e)                                                                \
+    do                                                                          \
+    {                                                                           \
+        if (!(e))                                                               \
+        {                                                                       \
+            std::printf("%s:%d: CHECK(%s) failed.\n", __FILE__, __LINE__, #e); \
+            testFailures_++;                                                    \
+        }                                                                       \
+    } while (0)
+
+inline int TestResult()
+{
+    if (testFailures_ > 0)
+        std::printf("%u checks failed.\n", testFailures_);
+    else
+        std::printf("All checks passed.\n");
+    return (testFailures_ > 0 ? 1 : 0);
+}
+
+// Each test executable is one file, so it gets App's instance from here.
+App& App::Get()
+{
+    static App app;
+    return app;
+}
+
+#endif // TEST_HPP
@@ -0,0 +1,198 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "test.hpp"
+#include "entity_manager.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <vector>
+
+static const uint32 ENTITIES_ = 100000;
+
+struct Position_ { uint32 id; float32 x; };
+struct Velocity_ { float32 dx; };
+struct Tag_      { uint32 id; };
+
+// Not trivially copyable, so it's relocated by its move constructor; counts
+// the live ones to check each is destroyed once.
+struct Tracked_
+{
+    static inline int32 live = 0;
+
+    uint32 id;
+
+    explicit Tracked_(uint32 i) : id(i) { live++; }
+    Tracked_(Tracked_&& o) : id(o.id) { live++; }
+    Tracked_(const Tracked_& o) : id(o.id) { live++; }
+    Tracked_& operator=(const Tracked_&) = default;
+    ~Tracked_() { live--; }
+};
+
+// Which of the five archetypes entity i starts in.
+static uint32 Shape_(uint32 i) { return i % 5; }
+
+static Entity CreateShape_(EntityManager& em, uint32 i)
+{
+    switch (Shape_(i))
+    {
+    case 0:  return em.Create(Position_{i, 0.0f});
+    case 1:  return em.Create(Position_{i, 0.0f}, Velocity_{1.0f});
+    case 2:  return em.Create(Position_{i, 0.0f}, Velocity_{1.0f}, Tag_{i});
+    case 3:  return em.Create(Position_{i, 0.0f}, Tracked_(i));
+    default: return em.Create(Position_{i, 0.0f}, Velocity_{1.0f}, Tag_{i}, Tracked_(i));
+    }
+}
+
+// Every entity's components are still its own.
+static bool Intact_(EntityManager& em, Entity e, uint32 i)
+{
+    Position_* p = em.Get<Position_>(e);
+    Tag_*      t = em.Get<Tag_>(e);
+    Tracked_*  k = em.Get<Tracked_>(e);
+    return (p && p->id == i && (!t || t->id == i) && (!k || k->id == i));
+}
+
+static void TestAddRemoveDestroy_()
+{
+    EntityManager em;
+
+    Entity e = em.Create();
+    CHECK(!e.IsNull() && em.IsAlive(e));
+    CHECK(!em.Has<Position_>(e) && !em.Get<Position_>(e));
+
+    CHECK(em.Add<Position_>(e, Position_{7, 1.5f}));
+    CHECK(em.Add<Velocity_>(e, Velocity_{2.0f}));
+    CHECK(em.Get<Position_>(e)->id == 7 && em.Get<Position_>(e)->x == 1.5f);
+    CHECK(em.Get<Velocity_>(e)->dx == 2.0f);
+
+    // Adding what it has assigns.
+    CHECK(em.Add<Position_>(e, Position_{8, 2.5f})->id == 8);
+    CHECK((em.Count<Position_, Velocity_>() == 1));
+
+    CHECK(em.Remove<Position_>(e));
+    CHECK(!em.Has<Position_>(e) && em.Get<Velocity_>(e)->dx == 2.0f);
+    CHECK(em.Remove<Position_>(e)); // Didn't have one.
+    CHECK(em.Count<Position_>() == 0 && em.Count<Velocity_>() == 1);
+
+    CHECK(em.Destroy(e));
+    CHECK(!em.IsAlive(e) && !em.Destroy(e));
+    CHECK(!em.Add<Position_>(e, Position_{}) && !em.Remove<Position_>(e) && !em.Get<Velocity_>(e));
+    CHECK(em.Count() == 0 && em.Count<Velocity_>() == 0);
+
+    // The index is reused, but not the handle.
+    Entity reused = em.Create(Tag_{1});
+    CHECK(reused.index == e.index && !(reused == e));
+    CHECK(!em.IsAlive(e) && em.IsAlive(reused));
+}
+
+// 100k entities across five archetypes, then moved between them and
+// destroyed in bulk; every survivor keeps its values, and counts and queries
+// agree with what's left.
+static void TestArchetypeMoves_()
+{
+    Tracked_::live = 0;
+    {
+        EntityManager em;
+        std::vector<Entity> entities;
+        for (uint32 i = 0; i < ENTITIES_; i++)
+            entities.push_back(CreateShape_(em, i));
+
+        CHECK(em.Count() == ENTITIES_);
+        CHECK(em.Count<Position_>() == ENTITIES_);
+        CHECK(em.Count<Velocity_>() == ENTITIES_ / 5 * 3);
+        CHECK((em.Count<Velocity_, Tag_>() == ENTITIES_ / 5 * 2));
+        CHECK(Tracked_::live == (int32)(ENTITIES_ / 5 * 2));
+
+        // Every third gets a Velocity, every seventh loses its Tag, which
+        // swaps rows around in every archetype.
+        for (uint32 i = 0; i < ENTITIES_; i += 3)
+            CHECK(em.Add<Velocity_>(entities[i], Velocity_{3.0f}));
+        for (uint32 i = 0; i < ENTITIES_; i += 7)
+            CHECK(em.Remove<Tag_>(entities[i]));
+
+        // Every fourth is destroyed.
+        for (uint32 i = 0; i < ENTITIES_; i += 4)
+            CHECK(em.Destroy(entities[i]));
+
+        uint32 alive = 0, velocities = 0, tags = 0, tracked = 0;
+        bool intact = true;
+        for (uint32 i = 0; i < ENTITIES_; i++)
+        {
+            uint32 shape = Shape_(i);
+            bool   dead  = (i % 4 == 0);
+            intact = intact && (em.IsAlive(entities[i]) == !dead);
+            if (dead)
+                continue;
+
+            bool velocity = (shape == 1 || shape == 2 || shape == 4 || i % 3 == 0);
+            bool tag      = ((shape == 2 || shape == 4) && i % 7 != 0);
+            bool track    = (shape == 3 || shape == 4);
+            intact = intact && Intact_(em, entities[i], i) &&
+                     em.Has<Velocity_>(entities[i]) == velocity &&
+                     em.Has<Tag_>(entities[i]) == tag &&
+                     em.Has<Tracked_>(entities[i]) == track;
+
+            // Adding one to those that had one assigned it.
+            if (velocity)
+                intact = intact && em.Get<Velocity_>(entities[i])->dx == (i % 3 == 0 ? 3.0f : 1.0f);
+
+            alive++;
+            velocities += velocity;
+            tags       += tag;
+            tracked    += track;
+        }
+        CHECK(intact);
+        CHECK(em.Count() == alive);
+        CHECK(em.Count<Position_>() == alive);
+        CHECK(em.Count<Velocity_>() == velocities);
+        CHECK(em.Count<Tag_>() == tags);
+        CHECK(Tracked_::live == (int32)tracked);
+
+        // Each() visits every entity with the components once.
+        uint64 sum = 0, expected = 0;
+        uint32 visited = 0;
+        em.Each<const Position_, Velocity_>([&](const Position_& p, Velocity_& v)
+        {
+            sum += p.id;
+            visited++;
+            v.dx += 1.0f;
+        });
+        for (uint32 i = 0; i < ENTITIES_; i++)
+        {
+            if (i % 4 != 0 && em.Has<Velocity_>(entities[i]))
+                expected += i;
+        }
+        CHECK(visited == velocities && sum == expected);
+
+        // So does ParallelEach().
+        ThreadPool pool(3);
+        std::atomic<uint64> parallelSum{0};
+        std::atomic<uint32> parallelVisited{0};
+        em.ParallelEach<const Position_, const Velocity_>(pool, [&](const Position_& p, const Velocity_&)
+        {
+            parallelSum += p.id;
+            parallelVisited++;
+        });
+        CHECK(parallelVisited == velocities && parallelSum == expected);
+
+        // Half the rest are destroyed, and the others left to ~EntityManager().
+        for (uint32 i = 2; i < ENTITIES_; i += 4)
+            CHECK(em.Destroy(entities[i]));
+        CHECK(em.Count() == alive - ENTITIES_ / 4);
+        CHECK(em.Count<Position_>() == em.Count());
+    }
+    // The EntityManager destroys what's left.
+    CHECK(Tracked_::live == 0);
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    TestAddRemoveDestroy_();
+    TestArchetypeMoves_();
+    return TestResult();
+}
@@ -0,0 +1,250 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "test.hpp"
+#include "event_bus.hpp"
+#include "mpsc_queue.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+EVENT_BEGIN(EventTestSequence)
+    uint32 producer;
+    uint32 n;
+EVENT_END(EventTestSequence)
+
+EVENT_BEGIN_PRIORITY(EventTestCritical, EventPriority::Critical)
+    uint32 producer;
+    uint32 n;
+EVENT_END(EventTestCritical)
+
+EVENT_BEGIN_PRIORITY(EventTestCosmetic, EventPriority::Deferrable)
+    uint32 producer;
+    uint32 n;
+EVENT_END(EventTestCosmetic)
+
+static const uint32 PRODUCERS_    = 8;
+static const uint32 PER_PRODUCER_ = 10000;
+
+// Everything pushed is popped once, in each producer's order.
+static void TestMPSCQueue_()
+{
+    struct Item
+    {
+        uint32 producer;
+        uint32 n;
+    };
+    MPSCQueue<Item> q;
+
+    std::vector<std::thread> producers;
+    for (uint32 p = 0; p < PRODUCERS_; p++)
+    {
+        producers.emplace_back([&q, p]
+        {
+            for (uint32 i = 0; i < PER_PRODUCER_; i++)
+                q.Push(Item{p, i});
+        });
+    }
+
+    std::vector<uint32> next(PRODUCERS_, 0);
+    uint32 popped  = 0;
+    bool   ordered = true;
+    Item   item;
+    while (popped < PRODUCERS_ * PER_PRODUCER_)
+    {
+        if (!q.Pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && (item.n == next[item.producer]);
+        next[item.producer] = item.n + 1;
+        popped++;
+    }
+
+    for (std::thread& t : producers)
+        t.join();
+    CHECK(ordered);
+    CHECK(!q.Pop(item));
+}
+
+// PublishThreadSafe() from several threads while Update() drains: nothing
+// lost or reordered, even with the Normal queue much smaller than the flood.
+static void TestPublishThreadSafe_()
+{
+    EventBus bus;
+    bus.SetQueueLimits(EventPriority::Normal, 256, EventOverflowPolicy::DropOldest);
+
+    std::vector<uint32> next(PRODUCERS_, 0);
+    uint32 received = 0;
+    bool   ordered  = true;
+    EventBus::Subscription s = bus.Subscribe<EventTestSequence>([&](const EventTestSequence& e)
+    {
+        ordered = ordered && (e.n == next[e.producer]);
+        next[e.producer] = e.n + 1;
+        received++;
+    });
+
+    std::atomic<uint32> started{0};
+    std::vector<std::thread> producers;
+    for (uint32 p = 0; p < PRODUCERS_; p++)
+    {
+        producers.emplace_back([&bus, &started, p]
+        {
+            started++;
+            for (uint32 i = 0; i < PER_PRODUCER_; i++)
+                bus.PublishThreadSafe<EventTestSequence>(p, i);
+        });
+    }
+
+    while (started < PRODUCERS_)
+        std::this_thread::yield();
+    for (uint32 frames = 0; received < PRODUCERS_ * PER_PRODUCER_ && frames < 1000000; frames++)
+        bus.Update();
+
+    for (std::thread& t : producers)
+        t.join();
+    bus.Update();
+
+    CHECK(received == PRODUCERS_ * PER_PRODUCER_);
+    CHECK(ordered);
+    CHECK(bus.ThreadSafeQueueStats().overflows == 0);
+    CHECK(bus.ThreadSafeQueueStats().size == 0);
+    CHECK(bus.ShedCount() == 0);
+}
+
+// A flood of Deferrable events past the thread-safe capacity only drops the
+// oldest Deferrable ones, never the Critical ones waiting with them, and every
+// drop is counted.
+static void TestThreadSafeOverflow_()
+{
+    static const uint32 CAPACITY_ = 64;
+
+    // Everything published before one Update().
+    {
+        EventBus bus;
+        bus.SetThreadSafeCapacity(CAPACITY_);
+
+        std::vector<uint32> critical;
+        std::vector<uint32> cosmetic;
+        EventBus::Subscription c = bus.Subscribe<EventTestCritical>([&](const EventTestCritical& e) { critical.push_back(e.n); });
+        EventBus::Subscription d = bus.Subscribe<EventTestCosmetic>([&](const EventTestCosmetic& e) { cosmetic.push_back(e.n); });
+
+        std::thread producer([&bus]
+        {
+            for (uint32 i = 0; i < 10; i++)
+                bus.PublishThreadSafe<EventTestCritical>(0u, i);
+            for (uint32 i = 0; i < 200; i++)
+                bus.PublishThreadSafe<EventTestCosmetic>(0u, i);
+        });
+        producer.join();
+        bus.Update();
+        bus.Update();
+
+        // Past twice the capacity the newest are dropped, and Update() drops
+        // the oldest of the rest.
+        CHECK(critical.size() == 10);
+        CHECK(cosmetic.size() == CAPACITY_ - 10);
+        CHECK(!cosmetic.empty() && cosmetic.front() == CAPACITY_ && cosmetic.back() == CAPACITY_ * 2 - 10 - 1);
+        CHECK(bus.ShedCount() == 200 - (CAPACITY_ - 10));
+        CHECK(bus.Metrics(EventTestCosmetic::INDEX()).shed == CAPACITY_); // Just the oldest.
+        CHECK(bus.Metrics(EventTestCritical::INDEX()).shed == 0);
+        CHECK(bus.ThreadSafeQueueStats().overflows == 200 - (CAPACITY_ - 10));
+        CHECK(bus.ThreadSafeQueueStats().size == 0);
+    }
+
+    // Several producers mixing the two while Update() drains.
+    {
+        EventBus bus;
+        bus.SetThreadSafeCapacity(CAPACITY_);
+
+        std::vector<uint32> nextCritical(PRODUCERS_, 0);
+        uint32 critical = 0;
+        uint32 cosmetic = 0;
+        bool   ordered  = true;
+        EventBus::Subscription c = bus.Subscribe<EventTestCritical>([&](const EventTestCritical& e)
+        {
+            ordered = ordered && (e.n == nextCritical[e.producer]);
+            nextCritical[e.producer] = e.n + 1;
+            critical++;
+        });
+        EventBus::Subscription d = bus.Subscribe<EventTestCosmetic>([&](const EventTestCosmetic&) { cosmetic++; });
+
+        std::atomic<uint32> done{0};
+        std::vector<std::thread> producers;
+        for (uint32 p = 0; p < PRODUCERS_; p++)
+        {
+            producers.emplace_back([&bus, &done, p]
+            {
+                for (uint32 i = 0; i < PER_PRODUCER_; i++)
+                {
+                    if (i % 100 == 0)
+                        bus.PublishThreadSafe<EventTestCritical>(p, i / 100);
+                    bus.PublishThreadSafe<EventTestCosmetic>(p, i);
+                }
+                done++;
+            });
+        }
+
+        while (done < PRODUCERS_)
+            bus.Update();
+        for (std::thread& t : producers)
+            t.join();
+        bus.Update();
+        bus.Update();
+
+        CHECK(critical == PRODUCERS_ * PER_PRODUCER_ / 100);
+        CHECK(ordered);
+        CHECK(cosmetic + bus.ShedCount() == PRODUCERS_ * PER_PRODUCER_);
+        CHECK(bus.Metrics(EventTestCosmetic::INDEX()).shed <= bus.ShedCount());
+        CHECK(bus.Metrics(EventTestCritical::INDEX()).shed == 0);
+        CHECK(bus.ThreadSafeQueueStats().size == 0);
+    }
+}
+
+// Block on the main thread grows the queue to twice its capacity, then
+// drops the newest events, so memory stays bounded.
+static void TestBlockLimit_()
+{
+    static const uint32 CAPACITY_ = 16;
+
+    EventBus bus;
+    bus.SetQueueLimits(EventPriority::Critical, CAPACITY_, EventOverflowPolicy::Block);
+    bus.SetThreadSafeCapacity(CAPACITY_);
+
+    std::vector<uint32> received;
+    EventBus::Subscription c = bus.Subscribe<EventTestCritical>([&](const EventTestCritical& e) { received.push_back(e.n); });
+
+    for (uint32 i = 0; i < 100; i++)
+        bus.Publish<EventTestCritical>(0u, i);
+    CHECK(bus.QueueStats(EventPriority::Critical).capacity == CAPACITY_ * 2);
+    CHECK(bus.QueueStats(EventPriority::Critical).size == CAPACITY_ * 2);
+    bus.Update();
+    CHECK(received.size() == CAPACITY_ * 2 && received.back() == CAPACITY_ * 2 - 1);
+    CHECK(bus.ShedCount() == 100 - CAPACITY_ * 2);
+
+    // The same for the thread-safe queue, from the main thread.
+    received.clear();
+    for (uint32 i = 0; i < 100; i++)
+        bus.PublishThreadSafe<EventTestCritical>(0u, i);
+    CHECK(bus.ThreadSafeQueueStats().size == CAPACITY_ * 2);
+    bus.Update();
+    bus.Update();
+    CHECK(received.size() == CAPACITY_ * 2 && received.back() == CAPACITY_ * 2 - 1);
+    CHECK(bus.ShedCount() == (100 - CAPACITY_ * 2) * 2);
+    CHECK(bus.QueueStats(EventPriority::Critical).capacity == CAPACITY_ * 2);
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    TestMPSCQueue_();
+    TestPublishThreadSafe_();
+    TestThreadSafeOverflow_();
+    TestBlockLimit_();
+    return TestResult();
+}
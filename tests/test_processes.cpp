@@ -0,0 +1,369 @@
+/*
+    ==================================
+    Copyright (C) 2021 Daniel Tyler.
+      This file is part of Ellie.
+    ==================================
+*/
+
+#include "test.hpp"
+#include "process_manager.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+
+static const uint32 PROCESSES_ = 2000;
+
+// Lives a few updates doing uneven amounts of work, then succeeds or fails;
+// the callbacks, which run on the thread calling Update(), log its id.
+class Worker_ : public Process
+{
+public:
+    Worker_(uint32 id, std::vector<uint32>& log, ProcessDispatch dispatch) : m_id(id), m_life(1 + id % 5), m_log(log)
+    {
+        SetDispatch(dispatch);
+    }
+
+protected:
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        for (uint32 i = 0; i < (m_id % 7) * 500; i++)
+            m_x = m_x * 1664525u + 1013904223u;
+        if (--m_life > 0)
+            return;
+        if (m_id % 11 == 0)
+            Fail();
+        else
+            Succeed();
+    }
+
+    void OnSuccess() override { m_log.push_back(m_id); }
+    void OnFail()    override { m_log.push_back(m_id | 0x80000000); }
+
+private:
+    uint32               m_id;
+    uint32               m_life;
+    uint32               m_x = 1;
+    std::vector<uint32>& m_log;
+};
+
+// The callback log and per Update() counts, until everything's settled.
+static std::vector<uint32> RunWorkers_(ThreadPool* pool, ProcessDispatch dispatch)
+{
+    std::vector<uint32> log;
+    ProcessManager pm;
+    pm.SetThreadPool(pool);
+    for (uint32 i = 0; i < PROCESSES_; i++)
+    {
+        Process::StrongPtr p = ProcessManager::Create<Worker_>(i, log, dispatch);
+        // Every fourth has a child, attached on success from Settle_().
+        if (i % 4 == 0)
+            p->AttachChild(ProcessManager::Create<Worker_>(PROCESSES_ + i, log, dispatch));
+        pm.Attach(p);
+    }
+
+    while (pm.Count() > 0)
+    {
+        pm.Update(1.0f);
+        log.push_back(0xFFFF0000 | pm.LastSuccessCount());
+        log.push_back(0xFFFE0000 | pm.LastFailCount());
+    }
+    return log;
+}
+
+// Concurrent processes settle in the order they were visited, so callbacks,
+// attachments and counts match running everything on the main thread.
+static void TestConcurrentOrder_()
+{
+    std::vector<uint32> expected = RunWorkers_(nullptr, ProcessDispatch::MainThread);
+    CHECK(expected.size() > PROCESSES_);
+
+    ThreadPool pool(4);
+    for (uint32 run = 0; run < 5; run++)
+        CHECK(RunWorkers_(&pool, ProcessDispatch::Concurrent) == expected);
+
+    // Half and half: the concurrent ones settle after the main thread ones,
+    // but the same way every time.
+    std::vector<uint32> mixedExpected;
+    for (uint32 run = 0; run < 5; run++)
+    {
+        std::vector<uint32> log;
+        ProcessManager pm;
+        pm.SetThreadPool(&pool);
+        for (uint32 i = 0; i < PROCESSES_; i++)
+            pm.Spawn<Worker_>(i, log, (i % 2 ? ProcessDispatch::Concurrent : ProcessDispatch::MainThread));
+        while (pm.Count() > 0)
+            pm.Update(1.0f);
+
+        if (run == 0)
+            mixedExpected = log;
+        else
+            CHECK(log == mixedExpected);
+    }
+    CHECK(mixedExpected.size() == PROCESSES_);
+}
+
+// Succeeds, or fails, in its first update; counts its OnInit()s.
+class Step_ : public Process
+{
+public:
+    explicit Step_(bool succeed = true) : m_succeed(succeed) {}
+
+    uint32 inits = 0;
+
+protected:
+    void OnInit() override
+    {
+        inits++;
+        Process::OnInit();
+    }
+
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        if (m_succeed)
+            Succeed();
+        else
+            Fail();
+    }
+
+private:
+    bool m_succeed;
+};
+
+// Sleeps until a process dies, then succeeds.
+class Waiter_ : public Process
+{
+public:
+    explicit Waiter_(Process::StrongPtr target) : m_target(std::move(target)) {}
+
+    bool slept = false;
+
+protected:
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        if (!slept)
+            slept = SleepUntilProcess(m_target);
+        else
+            Succeed();
+    }
+
+private:
+    Process::StrongPtr m_target;
+};
+
+static void UpdateUntilEmpty_(ProcessManager& pm)
+{
+    for (uint32 frames = 0; pm.Count() > 0 && frames < 100; frames++)
+        pm.Update(1.0f);
+}
+
+static void TestDependencies_()
+{
+    // Released once both prerequisites succeed, in the same Update().
+    {
+        ProcessManager pm;
+        std::shared_ptr<Step_> a = ProcessManager::Create<Step_>();
+        std::shared_ptr<Step_> b = ProcessManager::Create<Step_>();
+        std::shared_ptr<Step_> d = ProcessManager::Create<Step_>();
+        CHECK(d->AddPrerequisite(a) && d->AddPrerequisite(b));
+        CHECK(d->PendingPrerequisites() == 2);
+
+        pm.Attach(d); // Waits for a and b.
+        CHECK(pm.Count() == 0);
+        pm.Attach(a);
+        pm.Attach(b);
+        pm.Update(1.0f);
+        CHECK(a->State() == Process::State::Succeeded && b->State() == Process::State::Succeeded);
+        CHECK(d->PendingPrerequisites() == 0 && pm.Count() == 1);
+        UpdateUntilEmpty_(pm);
+        CHECK(d->State() == Process::State::Succeeded && d->inits == 1);
+    }
+
+    // A prerequisite that's already succeeded isn't waited for.
+    {
+        ProcessManager pm;
+        std::shared_ptr<Step_> a = ProcessManager::Create<Step_>();
+        pm.Attach(a);
+        UpdateUntilEmpty_(pm);
+        CHECK(a->State() == Process::State::Succeeded);
+
+        std::shared_ptr<Step_> d = ProcessManager::Create<Step_>();
+        CHECK(a->AddDependent(d));
+        CHECK(d->PendingPrerequisites() == 0 && !a->HasDependents());
+        pm.Attach(d);
+        CHECK(pm.Count() == 1);
+        UpdateUntilEmpty_(pm);
+        CHECK(d->State() == Process::State::Succeeded);
+    }
+
+    // One that fails aborts its dependents, and theirs, without running them.
+    {
+        ProcessManager pm;
+        std::shared_ptr<Step_> a = ProcessManager::Create<Step_>(false);
+        std::shared_ptr<Step_> d = ProcessManager::Create<Step_>();
+        std::shared_ptr<Step_> e = ProcessManager::Create<Step_>();
+        CHECK(a->AddDependent(d) && d->AddDependent(e));
+        pm.Attach(a);
+        pm.Update(1.0f);
+        CHECK(a->State() == Process::State::Failed);
+        CHECK(d->State() == Process::State::Aborted && e->State() == Process::State::Aborted);
+        CHECK(d->PendingPrerequisites() == 0 && e->PendingPrerequisites() == 0);
+        CHECK(pm.LastFailCount() == 1 && pm.Count() == 0);
+    }
+
+    // One that's already failed aborts them right away; they're never
+    // attached, but whatever is waiting on them is woken.
+    {
+        ProcessManager pm;
+        std::shared_ptr<Step_> a = ProcessManager::Create<Step_>(false);
+        pm.Attach(a);
+        UpdateUntilEmpty_(pm);
+        CHECK(a->State() == Process::State::Failed);
+
+        std::shared_ptr<Step_> d = ProcessManager::Create<Step_>();
+        std::shared_ptr<Step_> e = ProcessManager::Create<Step_>();
+        std::shared_ptr<Step_> f = ProcessManager::Create<Step_>();
+        CHECK(d->AddDependent(e) && f->AddDependent(e));
+        CHECK(e->PendingPrerequisites() == 2);
+
+        std::shared_ptr<Waiter_> w = ProcessManager::Create<Waiter_>(d);
+        pm.Attach(w);
+        pm.Update(1.0f);
+        CHECK(w->slept && w->IsSleeping());
+
+        CHECK(a->AddDependent(d));
+        CHECK(d->State() == Process::State::Aborted && e->State() == Process::State::Aborted);
+        CHECK(e->PendingPrerequisites() == 1 && f->State() == Process::State::Uninitialized);
+
+        pm.Attach(d);
+        pm.Attach(e);
+        CHECK(pm.Count() == 1); // Just w.
+        UpdateUntilEmpty_(pm);
+        CHECK(w->State() == Process::State::Succeeded);
+        CHECK(d->inits == 0 && e->inits == 0);
+
+        // f still runs, and succeeding doesn't release e.
+        pm.Attach(f);
+        UpdateUntilEmpty_(pm);
+        CHECK(f->State() == Process::State::Succeeded);
+        CHECK(e->inits == 0 && pm.Count() == 0);
+    }
+}
+
+// Records the frames it ran in.
+class Recorder_ : public Process
+{
+public:
+    explicit Recorder_(const uint32& frame) : m_frame(frame) {}
+
+    std::vector<uint32> frames;
+
+protected:
+    void OnUpdate(DeltaTime /*dt*/) override { frames.push_back(m_frame); }
+
+private:
+    const uint32& m_frame;
+};
+
+// Runs every frame regardless of the budget, and succeeds after life runs.
+class Mortal_ : public Process
+{
+public:
+    explicit Mortal_(uint32 life) : m_life(life) { SetMinUpdateRate(1000000.0f); }
+
+protected:
+    void OnUpdate(DeltaTime /*dt*/) override
+    {
+        if (--m_life == 0)
+            Succeed();
+    }
+
+private:
+    uint32 m_life;
+};
+
+// A budget so tight that one process runs a frame, while processes around
+// them settle and are compacted away: round-robin still reaches every
+// skipped process in turn.
+static void TestRoundRobin_()
+{
+    static const uint32 RECORDERS_ = 20;
+    static const uint32 FRAMES_    = 400;
+
+    ProcessManager pm;
+    uint32 frame = 0;
+    std::vector<std::shared_ptr<Recorder_>> recorders;
+    for (uint32 i = 0; i < RECORDERS_; i++)
+    {
+        recorders.push_back(ProcessManager::Create<Recorder_>(frame));
+        pm.Attach(recorders.back());
+        pm.Spawn<Mortal_>(1 + i % 4);
+    }
+
+    for (; frame < FRAMES_; frame++)
+    {
+        pm.Update(1.0f, true, 0.0f);
+        for (uint32 i = 0; i < 3; i++)
+            pm.Spawn<Mortal_>(1 + (frame + i) % 4);
+    }
+
+    // Each runs once every RECORDERS_ frames.
+    uint32 longestGap = 0;
+    for (const auto& r : recorders)
+    {
+        CHECK(!r->frames.empty());
+        uint32 last = 0;
+        for (uint32 f : r->frames)
+        {
+            if (f - last > longestGap)
+                longestGap = f - last;
+            last = f;
+        }
+        if (FRAMES_ - last > longestGap)
+            longestGap = FRAMES_ - last;
+    }
+    CHECK(longestGap <= RECORDERS_);
+}
+
+// A process asleep in one ProcessManager, waiting on a process in another,
+// is woken into its own when that one dies.
+static void TestCrossManagerWake_()
+{
+    ProcessManager logic;
+    ProcessManager view;
+
+    std::shared_ptr<Step_>   target = ProcessManager::Create<Step_>();
+    std::shared_ptr<Waiter_> w      = ProcessManager::Create<Waiter_>(target);
+    logic.Attach(w);
+    logic.Update(1.0f);
+    logic.Update(1.0f);
+    CHECK(w->IsSleeping() && logic.SleepingCount() == 1);
+
+    view.Attach(target);
+    view.Update(1.0f);
+    CHECK(target->State() == Process::State::Succeeded);
+    CHECK(logic.SleepingCount() == 0 && view.SleepingCount() == 0);
+    CHECK(logic.Count() == 1 && view.Count() == 0);
+
+    logic.Update(1.0f);
+    CHECK(w->State() == Process::State::Succeeded && logic.Count() == 0);
+
+    // Waking it through the other manager works too.
+    std::shared_ptr<Step_>   never = ProcessManager::Create<Step_>();
+    std::shared_ptr<Waiter_> w2    = ProcessManager::Create<Waiter_>(never);
+    logic.Attach(w2);
+    logic.Update(1.0f);
+    CHECK(w2->IsSleeping() && logic.SleepingCount() == 1);
+    view.Wake(*w2);
+    CHECK(logic.SleepingCount() == 0 && logic.Count() == 1);
+    logic.Update(1.0f);
+    CHECK(w2->State() == Process::State::Succeeded);
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    TestConcurrentOrder_();
+    TestDependencies_();
+    TestRoundRobin_();
+    TestCrossManagerWake_();
+    return TestResult();
+}